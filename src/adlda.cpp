@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <thread>
+#include "dataset.h"
+#include "model.h"
+#include "adlda.h"
+
+using namespace std;
+
+adlda::adlda(model *pmodel, int nthreads, int syncstep) {
+	this->pmodel = pmodel;
+	this->nthreads = nthreads;
+	this->syncstep = syncstep;
+
+	long ntokens = pmodel->ptrndata->ntokens();
+
+	// split the documents into contiguous ranges with about the same number of words
+	workers.resize(nthreads);
+	int m = 0;
+	long cumulated = 0;
+	for (int t = 0; t < nthreads; t++) {
+		worker &wk = workers[t];
+		wk.mbegin = m;
+		long target = ntokens * (t + 1) / nthreads;
+		while (m < pmodel->M && (cumulated < target || t == nthreads - 1)) {
+			cumulated += pmodel->ptrndata->length(m);
+			m++;
+		}
+		wk.mend = m;
+		wk.mnext = m;
+
+		wk.dnw = new int *[pmodel->V];
+		for (int w = 0; w < pmodel->V; w++) {
+			wk.dnw[w] = nullptr;
+		}
+		wk.dnwsum = new int[pmodel->K];
+		for (int k = 0; k < pmodel->K; k++) {
+			wk.dnwsum[k] = 0;
+		}
+		wk.marked.assign(pmodel->V, 0);
+		wk.p = new double[pmodel->K];
+		wk.gen = rng(pmodel->seed, t + 1);
+	}
+}
+
+adlda::~adlda() {
+	for (auto &wk : workers) {
+		for (int w = 0; w < pmodel->V; w++) {
+			delete[] wk.dnw[w];
+		}
+		delete[] wk.dnw;
+		delete[] wk.dnwsum;
+		delete[] wk.p;
+	}
+}
+
+void adlda::iteration() {
+	for (auto &wk : workers) {
+		wk.mnext = wk.mbegin;
+	}
+
+	bool done = false;
+	while (!done) {
+		vector<thread> threads;
+		for (int t = 1; t < nthreads; t++) {
+			threads.emplace_back(&adlda::run, this, ref(workers[t]));
+		}
+		run(workers[0]);
+		for (auto &th : threads) {
+			th.join();
+		}
+
+		merge();
+
+		done = true;
+		for (auto &wk : workers) {
+			if (wk.mnext < wk.mend) {
+				done = false;
+			}
+		}
+	}
+}
+
+void adlda::run(worker &wk) {
+	int mstop = wk.mend;
+	if (syncstep > 0 && wk.mnext + syncstep < mstop) {
+		mstop = wk.mnext + syncstep;
+	}
+
+	const vector<size_t> &offsets = pmodel->ptrndata->offsets;
+	for (int m = wk.mnext; m < mstop; m++) {
+		for (size_t i = offsets[m]; i < offsets[m + 1]; i++) {
+			pmodel->z.set(i, sampling(wk, m, i));
+		}
+	}
+	wk.mnext = mstop;
+}
+
+/**
+ * Same full conditional as model::sampling, with nw and nwsum seen as the shared counts from the last merge
+ * plus the changes this thread made since then.
+ */
+int adlda::sampling(worker &wk, int m, size_t i) {
+	int K = pmodel->K;
+	int topic = pmodel->z.get(i);
+	int w = pmodel->ptrndata->words[i];
+
+	if (!wk.dnw[w]) {
+		wk.dnw[w] = new int[K]();
+	}
+	if (!wk.marked[w]) {
+		wk.marked[w] = 1;
+		wk.touched.push_back(w);
+	}
+
+	int *nww = pmodel->nw[w];
+	int *dnww = wk.dnw[w];
+	ndcount *ndm = pmodel->nd[m];
+	int *nwsum = pmodel->nwsum;
+	int *dnwsum = wk.dnwsum;
+
+	// remove z_i from the count variables
+	dnww[topic] -= 1;
+	ndm[topic] -= 1;
+	dnwsum[topic] -= 1;
+	pmodel->ndsum[m] -= 1;
+
+	double Vbeta = pmodel->V * pmodel->beta;
+	double alpha = pmodel->alpha;
+	double beta = pmodel->beta;
+	double *p = wk.p;
+	// the document denominator (ndsum[m] + K * alpha) is the same for all topics and is left out
+	for (int k = 0; k < K; k++) {
+		p[k] = (nww[k] + dnww[k] + beta) / (nwsum[k] + dnwsum[k] + Vbeta) * (ndm[k] + alpha);
+	}
+	for (int k = 1; k < K; k++) {
+		p[k] += p[k - 1];
+	}
+	double u = wk.gen.uniform() * p[K - 1];
+
+	for (topic = 0; topic < K - 1; topic++) {
+		if (p[topic] > u) {
+			break;
+		}
+	}
+
+	// add newly estimated z_i to count variables
+	dnww[topic] += 1;
+	ndm[topic] += 1;
+	dnwsum[topic] += 1;
+	pmodel->ndsum[m] += 1;
+
+	return topic;
+}
+
+void adlda::merge() {
+	vector<thread> threads;
+	for (int t = 1; t < nthreads; t++) {
+		threads.emplace_back(&adlda::merge_stripe, this, t);
+	}
+	merge_stripe(0);
+	for (auto &th : threads) {
+		th.join();
+	}
+
+	for (auto &wk : workers) {
+		for (int k = 0; k < pmodel->K; k++) {
+			pmodel->nwsum[k] += wk.dnwsum[k];
+			wk.dnwsum[k] = 0;
+		}
+		wk.touched.clear();
+	}
+}
+
+void adlda::merge_stripe(int stripe) {
+	int K = pmodel->K;
+	for (auto &wk : workers) {
+		for (int w : wk.touched) {
+			if (w % nthreads != stripe) {
+				continue;
+			}
+
+			int *nww = pmodel->nw[w];
+			int *dnww = wk.dnw[w];
+			for (int k = 0; k < K; k++) {
+				nww[k] += dnww[k];
+				dnww[k] = 0;
+			}
+			wk.marked[w] = 0;
+		}
+	}
+}
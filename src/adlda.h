@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "Distributed algorithms for topic models" by David Newman, Arthur Asuncion, Padhraic Smyth and
+ *   Max Welling (JMLR 2009)
+ */
+
+#ifndef    _ADLDA_H
+#define    _ADLDA_H
+
+#include <vector>
+#include "rng.h"
+
+using namespace std;
+
+class model;
+
+// Approximate distributed LDA (AD-LDA) on worker threads
+//
+// The documents are split into nthreads contiguous ranges of about the same number of words. Every thread
+// samples its own documents against the shared nw/nwsum, which stay read-only while the threads run, plus
+// a private delta of its own changes. nd, ndsum and z rows belong to exactly one thread. The deltas are
+// added to nw/nwsum when all threads are done with the iteration, or after every syncstep documents.
+class adlda {
+public:
+	adlda(model *pmodel, int nthreads, int syncstep);
+
+	~adlda();
+
+	// one Gibbs sweep over all documents
+	void iteration();
+
+private:
+	struct worker {
+		int mbegin, mend; // document range [mbegin, mend)
+		int mnext; // next document to sample in this iteration
+		int **dnw; // delta of nw, rows allocated when the thread first touches the word
+		int *dnwsum; // delta of nwsum
+		vector<int> touched; // rows of dnw changed since the last merge
+		vector<char> marked; // marked[w] is set if w is in touched
+		double *p;
+		rng gen; // stream of its own, see model::seed
+	};
+
+	model *pmodel;
+	int nthreads;
+	int syncstep;
+	vector<worker> workers;
+
+	// sample documents [mnext, mend) of a worker, at most syncstep of them if syncstep > 0
+	void run(worker &wk);
+
+	int sampling(worker &wk, int m, size_t i);
+
+	// add the deltas of all workers to nw/nwsum, words are striped over the threads
+	void merge();
+
+	void merge_stripe(int stripe);
+};
+
+#endif
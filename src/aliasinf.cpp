@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include "model.h"
+#include "aliasinf.h"
+
+using namespace std;
+
+aliasinf::aliasinf(model *pmodel) {
+	this->pmodel = pmodel;
+	K = pmodel->K;
+	alpha = pmodel->alpha;
+	beta = pmodel->beta;
+	Kalpha = K * alpha;
+	mhsteps = pmodel->mhsteps;
+	invsum = pmodel->fixedinvsum.data();
+
+	vector<int> small, large;
+	vector<double> mass;
+
+	wtables.resize(pmodel->V);
+	for (int w = 0; w < pmodel->V; w++) {
+		wordtable &wt = wtables[w];
+		const int *nww = pmodel->nw[w];
+		mass.clear();
+		wt.sum = 0.0;
+		for (int k = 0; k < K; k++) {
+			if (nww[k] > 0) {
+				wt.topics.push_back(k);
+				mass.push_back(nww[k] * invsum[k]);
+				wt.sum += mass.back();
+			}
+		}
+		if (!wt.topics.empty()) {
+			wt.table.build(mass.data(), (int) wt.topics.size(), wt.sum, small, large);
+		}
+	}
+
+	mass.resize(K);
+	ssum = 0.0;
+	for (int k = 0; k < K; k++) {
+		mass[k] = beta * invsum[k];
+		ssum += mass[k];
+	}
+	stable.build(mass.data(), K, ssum, small, large);
+}
+
+int aliasinf::sample(int w, int s0, const ndcount *ndm, const int *topics, size_t n, rng &gen) const {
+	const int *nww = pmodel->nw[w];
+	const wordtable &wt = wtables[w];
+	int s = s0;
+	double phis = (nww[s] + beta) * invsum[s];
+
+	for (int step = 0; step < mhsteps; step++) {
+		// doc proposal, q_d(k) ~ nd[k] + alpha with the token still counted as s0
+		int t;
+		if (gen.uniform() * (n + Kalpha) < n) {
+			t = topics[gen.below((int) n)];
+		} else {
+			t = gen.below(K);
+		}
+		if (t != s) {
+			double phit = (nww[t] + beta) * invsum[t];
+			double accept = (ndm[t] + alpha) * phit * (ndm[s] + (s == s0) + alpha) /
+							((ndm[s] + alpha) * phis * (ndm[t] + (t == s0) + alpha));
+			if (gen.uniform() < accept) {
+				s = t;
+				phis = phit;
+			}
+		}
+
+		// word proposal, q_w(k) ~ phi_w(k) exactly, so only the document part is left in the ratio
+		if (gen.uniform() * (wt.sum + ssum) < wt.sum) {
+			t = wt.topics[wt.table.sample(gen.uniform())];
+		} else {
+			t = stable.sample(gen.uniform());
+		}
+		if (t != s) {
+			double accept = (ndm[t] + alpha) / (ndm[s] + alpha);
+			if (gen.uniform() < accept) {
+				s = t;
+				phis = (nww[t] + beta) * invsum[t];
+			}
+		}
+	}
+
+	return s;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "Reducing the sampling complexity of topic models" by Aaron Q. Li, Amr Ahmed, Sujith Ravi and
+ *   Alexander J. Smola (KDD 2014)
+ * + "LightLDA: Big topic models on modest computer clusters" by Jinhui Yuan et al. (WWW 2015)
+ */
+
+#ifndef    _ALIASINF_H
+#define    _ALIASINF_H
+
+#include <vector>
+#include "aliaslda.h"
+#include "matrix.h"
+#include "rng.h"
+
+using namespace std;
+
+class model;
+
+// Metropolis-Hastings inference over the fixed model
+//
+// With nw and nwsum frozen, phi_w(k) ~ (nw[w][k] + beta) / (nwsum[k] + Vbeta) never changes, so the alias tables of
+// the word proposal q_w(k) ~ phi_w(k) are built once and are exact. For a token of word w the target is
+//   p(k) ~ (nd[k] + alpha) * phi_w(k)
+// and every MH step alternates two proposals:
+//   doc proposal:  q_d(k) ~ nd[k] + alpha, the topic of a random word of the document, accepted by phi_w(t) / phi_w(s)
+//   word proposal: q_w(k), a mixture of a table over the nonzero topics of nw[w] and a smoothing table shared by all
+//                  words, accepted by (nd[t] + alpha) / (nd[s] + alpha)
+// so a draw costs O(mhsteps) whatever K is. The tables are only read and may be shared by any number of threads.
+class aliasinf {
+public:
+	explicit aliasinf(model *pmodel);
+
+	// a new topic for a token of word w with topic s0, ndm without the token, topics the n topics of its
+	// document, which still hold s0 for the token
+	int sample(int w, int s0, const ndcount *ndm, const int *topics, size_t n, rng &gen) const;
+
+private:
+	// nw[w][k] / (nwsum[k] + Vbeta) over the nonzero topics of one word
+	struct wordtable {
+		vector<int> topics;
+		alias_table table;
+		double sum;
+	};
+
+	model *pmodel;
+	int K;
+	double alpha, beta, Kalpha;
+	int mhsteps;
+	const double *invsum; // 1 / (nwsum[k] + Vbeta), the fixedinvsum of the model
+
+	vector<wordtable> wtables; // size V
+	alias_table stable; // beta / (nwsum[k] + Vbeta)
+	double ssum;
+};
+
+#endif
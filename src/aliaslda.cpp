@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <algorithm>
+#include "dataset.h"
+#include "model.h"
+#include "aliaslda.h"
+
+using namespace std;
+
+void alias_table::build(const double *weights, int n, double sum, vector<int> &small, vector<int> &large) {
+	prob.resize(n);
+	alias.resize(n);
+	small.clear();
+	large.clear();
+
+	for (int i = 0; i < n; i++) {
+		prob[i] = weights[i] * n / sum;
+		alias[i] = i;
+		if (prob[i] < 1.0) {
+			small.push_back(i);
+		} else {
+			large.push_back(i);
+		}
+	}
+
+	// pair every under-full slot with an over-full one (Vose's method)
+	while (!small.empty() && !large.empty()) {
+		int s = small.back();
+		int l = large.back();
+		small.pop_back();
+
+		alias[s] = l;
+		prob[l] -= 1.0 - prob[s];
+		if (prob[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// whatever is left is full up to rounding errors
+	for (int i : small) {
+		prob[i] = 1.0;
+	}
+	for (int i : large) {
+		prob[i] = 1.0;
+	}
+}
+
+aliaslda::aliaslda(model *pmodel) {
+	this->pmodel = pmodel;
+	K = pmodel->K;
+	alpha = pmodel->alpha;
+	beta = pmodel->beta;
+	Vbeta = pmodel->V * beta;
+	Kalpha = K * alpha;
+	mhsteps = pmodel->mhsteps;
+
+	// all tables start out stale and are built on first use
+	wtables.resize(pmodel->V);
+	for (auto &wt : wtables) {
+		wt.sum = 0.0;
+		wt.draws = 0;
+	}
+	ssum = 0.0;
+	sdraws = 0;
+}
+
+void aliaslda::build_word(int w) {
+	wordtable &wt = wtables[w];
+	const int *nww = pmodel->nw[w];
+
+	wt.topics.clear();
+	wt.mass.clear();
+	wt.sum = 0.0;
+	for (int k = 0; k < K; k++) {
+		if (nww[k] > 0) {
+			double mass = nww[k] / (pmodel->nwsum[k] + Vbeta);
+			wt.topics.push_back(k);
+			wt.mass.push_back(mass);
+			wt.sum += mass;
+		}
+	}
+
+	if (!wt.topics.empty()) {
+		wt.table.build(wt.mass.data(), (int) wt.topics.size(), wt.sum, small, large);
+	}
+	wt.draws = K;
+}
+
+void aliaslda::build_smooth() {
+	smooth.resize(K);
+	ssum = 0.0;
+	for (int k = 0; k < K; k++) {
+		smooth[k] = beta / (pmodel->nwsum[k] + Vbeta);
+		ssum += smooth[k];
+	}
+
+	stable.build(smooth.data(), K, ssum, small, large);
+	sdraws = K;
+}
+
+double aliaslda::word_proposal(const wordtable &wt, int k) const {
+	double q = smooth[k];
+	auto it = lower_bound(wt.topics.begin(), wt.topics.end(), k);
+	if (it != wt.topics.end() && *it == k) {
+		q += wt.mass[it - wt.topics.begin()];
+	}
+	return q;
+}
+
+void aliaslda::sample_doc(int m) {
+	for (size_t i = pmodel->ptrndata->offsets[m]; i < pmodel->ptrndata->offsets[m + 1]; i++) {
+		pmodel->z.set(i, sampling(m, i));
+	}
+}
+
+void aliaslda::sample_word(int w) {
+	for (size_t j = pmodel->wordoffsets[w]; j < pmodel->wordoffsets[w + 1]; j++) {
+		size_t i = pmodel->wordtokens[j];
+		pmodel->z.set(i, sampling(pmodel->worddocs[j], i));
+	}
+}
+
+int aliaslda::sampling(int m, size_t i) {
+	const topicarray &z = pmodel->z;
+	ndcount *ndm = pmodel->nd[m];
+	int *nwsum = pmodel->nwsum;
+	size_t begin = pmodel->ptrndata->offsets[m];
+	int N = pmodel->ptrndata->length(m);
+	int w = pmodel->ptrndata->words[i];
+	int *nww = pmodel->nw[w];
+
+	// remove z_i from the count variables
+	int s0 = z.get(i);
+	nww[s0] -= 1;
+	ndm[s0] -= 1;
+	nwsum[s0] -= 1;
+	pmodel->ndsum[m] -= 1;
+
+	wordtable &wt = wtables[w];
+	rng &gen = pmodel->generator;
+	int s = s0;
+	double ps = (ndm[s] + alpha) * (nww[s] + beta) / (nwsum[s] + Vbeta);
+
+	for (int step = 0; step < mhsteps; step++) {
+		// doc proposal, q_d(k) ~ nd[m][k] + alpha with z_i still counted as s0 (z[i] is not updated yet)
+		int t;
+		if (gen.uniform() * (N + Kalpha) < N) {
+			t = z.get(begin + gen.below(N));
+		} else {
+			t = gen.below(K);
+		}
+		if (t != s) {
+			double pt = (ndm[t] + alpha) * (nww[t] + beta) / (nwsum[t] + Vbeta);
+			double accept = pt * (ndm[s] + (s == s0) + alpha) / (ps * (ndm[t] + (t == s0) + alpha));
+			if (gen.uniform() < accept) {
+				s = t;
+				ps = pt;
+			}
+		}
+
+		// word proposal, mixture of the sparse per-word table and the shared smoothing table
+		if (wt.draws <= 0) {
+			build_word(w);
+		}
+		if (sdraws <= 0) {
+			build_smooth();
+		}
+		wt.draws--;
+		sdraws--;
+
+		if (gen.uniform() * (wt.sum + ssum) < wt.sum) {
+			t = wt.topics[wt.table.sample(gen.uniform())];
+		} else {
+			t = stable.sample(gen.uniform());
+		}
+		if (t != s) {
+			double pt = (ndm[t] + alpha) * (nww[t] + beta) / (nwsum[t] + Vbeta);
+			double accept = pt * word_proposal(wt, s) / (ps * word_proposal(wt, t));
+			if (gen.uniform() < accept) {
+				s = t;
+				ps = pt;
+			}
+		}
+	}
+
+	// add newly estimated z_i to count variables
+	nww[s] += 1;
+	ndm[s] += 1;
+	nwsum[s] += 1;
+	pmodel->ndsum[m] += 1;
+
+	return s;
+}
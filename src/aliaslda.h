@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "Reducing the sampling complexity of topic models" by Aaron Q. Li, Amr Ahmed, Sujith Ravi and
+ *   Alexander J. Smola (KDD 2014)
+ * + "LightLDA: Big topic models on modest computer clusters" by Jinhui Yuan et al. (WWW 2015)
+ */
+
+#ifndef    _ALIASLDA_H
+#define    _ALIASLDA_H
+
+#include <vector>
+
+using namespace std;
+
+class model;
+
+// Walker/Vose alias table, draws from a discrete distribution in O(1)
+class alias_table {
+public:
+	vector<double> prob;
+	vector<int> alias;
+
+	// build the table from n unnormalized weights with the given sum
+	void build(const double *weights, int n, double sum, vector<int> &small, vector<int> &large);
+
+	// draw an index, u is uniform in [0, 1)
+	int sample(double u) const {
+		double x = u * prob.size();
+		int i = (int) x;
+		return (x - i < prob[i]) ? i : alias[i];
+	}
+};
+
+// Metropolis-Hastings sampler with alias-table proposals
+//
+// For z_i = k the target is
+//   p(k) ~ (nd[m][k] + alpha) * (nw[w][k] + beta) / (nwsum[k] + Vbeta)
+// and every MH step alternates two cheap proposals:
+//   doc proposal:  q_d(k) ~ nd[m][k] + alpha, drawn by picking the topic of a random word of the document
+//   word proposal: q_w(k) ~ (nw[w][k] + beta) / (nwsum[k] + Vbeta), drawn from alias tables that are only
+//                  rebuilt after K draws, so the O(K) build is amortized
+// The staleness of the word proposal is corrected by the acceptance ratio, which evaluates the proposal
+// with the same snapshot of the counts it was drawn from.
+class aliaslda {
+public:
+	explicit aliaslda(model *pmodel);
+
+	// resample all words of document m, updates z and the count variables
+	void sample_doc(int m);
+
+	// resample all occurrences of word w, walks pmodel->wordtokens
+	void sample_word(int w);
+
+private:
+	// snapshot of nw[w][k] / (nwsum[k] + Vbeta) over the nonzero topics of one word
+	struct wordtable {
+		vector<int> topics; // nonzero topics at build time, ascending
+		vector<double> mass;
+		alias_table table;
+		double sum;
+		int draws; // draws left before the table is considered stale
+	};
+
+	model *pmodel;
+	int K;
+	double alpha, beta, Vbeta, Kalpha;
+	int mhsteps;
+
+	vector<wordtable> wtables; // size V, built lazily
+	// snapshot of beta / (nwsum[k] + Vbeta), shared by all words
+	vector<double> smooth;
+	alias_table stable;
+	double ssum;
+	int sdraws;
+
+	vector<int> small, large; // scratch space for building tables
+
+	void build_word(int w);
+
+	void build_smooth();
+
+	// word proposal density, unnormalized, from the current snapshots
+	double word_proposal(const wordtable &wt, int k) const;
+
+	// resample word i of the corpus, which belongs to document m
+	int sampling(int m, size_t i);
+};
+
+#endif
@@ -21,55 +21,48 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
  */
 
-#include <string>
-#include "strtokenizer.h"
+#include "binwriter.h"
 
 using namespace std;
 
-strtokenizer::strtokenizer(const string& str, const string& seperators) {
-	idx = 0;
-	parse(str, seperators);
-}
-
-void strtokenizer::parse(const string& str, const string& seperators) {
-	int n = str.length();
-	int start, stop;
-
-	start = str.find_first_not_of(seperators);
-	while (start >= 0 && start < n) {
-		stop = str.find_first_of(seperators, start);
-		if (stop < 0 || stop > n) {
-			stop = n;
-		}
-
-		tokens.push_back(str.substr(start, stop - start));
-		start = str.find_first_not_of(seperators, stop + 1);
+binwriter::~binwriter() {
+	if (fout) {
+		fclose(fout);
+		remove(tmpfile.c_str());
 	}
-
-	start_scan();
 }
 
-int strtokenizer::count_tokens() {
-	return tokens.size();
+int binwriter::open(const string &filename) {
+	this->filename = filename;
+	tmpfile = filename + ".tmp";
+	fout = fopen(tmpfile.c_str(), "wb");
+	if (!fout) {
+		printf("Cannot open file %s to save!\n", tmpfile.c_str());
+		return 1;
+	}
+	return 0;
 }
 
-void strtokenizer::start_scan() {
-	idx = 0;
+void binwriter::pad(size_t bytes) {
+	static const char zeros[8] = {0};
+	fwrite(zeros, 1, padded(bytes) - bytes, fout);
 }
 
-string strtokenizer::next_token() {
-	if (idx >= 0 && idx < tokens.size()) {
-		return tokens[idx++];
-	} else {
-		return "";
+int binwriter::commit() {
+	int failed = ferror(fout);
+	if (fclose(fout) != 0) {
+		failed = 1;
 	}
-}
-
-string strtokenizer::token(int i) {
-	if (i >= 0 && i < tokens.size()) {
-		return tokens[i];
-	} else {
-		return "";
+	fout = nullptr;
+	if (failed) {
+		printf("Cannot write file %s!\n", tmpfile.c_str());
+		remove(tmpfile.c_str());
+		return 1;
 	}
+	if (rename(tmpfile.c_str(), filename.c_str()) != 0) {
+		printf("Cannot rename file %s to %s!\n", tmpfile.c_str(), filename.c_str());
+		remove(tmpfile.c_str());
+		return 1;
+	}
+	return 0;
 }
-
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _BINWRITER_H
+#define    _BINWRITER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+// A binary file written next to its final name and renamed over it by commit, so a reader never sees a partial
+// file. The binary corpus, the checkpoint and the inference export start their sections at multiples of 8 bytes.
+class binwriter {
+public:
+	binwriter() {
+		fout = nullptr;
+	}
+
+	// removes the temporary file unless it was committed
+	~binwriter();
+
+	binwriter(const binwriter &) = delete;
+
+	binwriter &operator=(const binwriter &) = delete;
+
+	// bytes rounded up to a multiple of 8
+	static size_t padded(size_t bytes) {
+		return (bytes + 7) / 8 * 8;
+	}
+
+	// open filename + ".tmp", returns 1 if it cannot be created
+	int open(const string &filename);
+
+	void write(const void *data, size_t size, size_t count) {
+		fwrite(data, size, count, fout);
+	}
+
+	// zeros up to the next multiple of 8 after a section of the given number of bytes
+	void pad(size_t bytes);
+
+	// close and rename to the final name, returns 1 if anything failed
+	int commit();
+
+private:
+	FILE *fout;
+	string filename;
+	string tmpfile;
+};
+
+#endif
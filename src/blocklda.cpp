@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <thread>
+#include <algorithm>
+#include "dataset.h"
+#include "model.h"
+#include "blocklda.h"
+
+using namespace std;
+
+blocklda::blocklda(model *pmodel, int nthreads) {
+	this->pmodel = pmodel;
+	this->nthreads = nthreads;
+
+	int M = pmodel->M;
+	int V = pmodel->V;
+	dataset *pdata = pmodel->ptrndata;
+
+	// word frequencies, to balance both partitions by number of words
+	vector<long> freq(V, 0);
+	long ntokens = pdata->ntokens();
+	for (long i = 0; i < ntokens; i++) {
+		freq[pdata->words[i]]++;
+	}
+
+	// vocabulary groups: most frequent words first, each to the lightest group so far
+	vector<int> order(V);
+	for (int w = 0; w < V; w++) {
+		order[w] = w;
+	}
+	sort(order.begin(), order.end(), [&freq](int a, int b) {
+		return freq[a] > freq[b];
+	});
+	vector<int> wgroup(V);
+	vector<long> load(nthreads, 0);
+	for (int w : order) {
+		int q = (int) (min_element(load.begin(), load.end()) - load.begin());
+		wgroup[w] = q;
+		load[q] += freq[w];
+	}
+
+	// document ranges: contiguous, about the same number of words each
+	blocks.resize((size_t) nthreads * nthreads);
+	int m = 0;
+	long cumulated = 0;
+	for (int p = 0; p < nthreads; p++) {
+		long target = ntokens * (p + 1) / nthreads;
+		while (m < M && (cumulated < target || p == nthreads - 1)) {
+			for (size_t i = pdata->offsets[m]; i < pdata->offsets[m + 1]; i++) {
+				block &b = blocks[p * nthreads + wgroup[pdata->words[i]]];
+				b.docs.push_back(m);
+				b.pos.push_back(i);
+			}
+			cumulated += pdata->length(m);
+			m++;
+		}
+	}
+
+	workers.resize(nthreads);
+	for (int t = 0; t < nthreads; t++) {
+		worker &wk = workers[t];
+		wk.dnwsum = new int[pmodel->K];
+		for (int k = 0; k < pmodel->K; k++) {
+			wk.dnwsum[k] = 0;
+		}
+		wk.p = new double[pmodel->K];
+		wk.gen = rng(pmodel->seed, t + 1);
+	}
+}
+
+blocklda::~blocklda() {
+	for (auto &wk : workers) {
+		delete[] wk.dnwsum;
+		delete[] wk.p;
+	}
+}
+
+void blocklda::iteration() {
+	for (int epoch = 0; epoch < nthreads; epoch++) {
+		vector<thread> threads;
+		for (int p = 1; p < nthreads; p++) {
+			threads.emplace_back(&blocklda::run, this, p, epoch);
+		}
+		run(0, epoch);
+		for (auto &th : threads) {
+			th.join();
+		}
+
+		for (auto &wk : workers) {
+			for (int k = 0; k < pmodel->K; k++) {
+				pmodel->nwsum[k] += wk.dnwsum[k];
+				wk.dnwsum[k] = 0;
+			}
+		}
+	}
+}
+
+void blocklda::run(int p, int epoch) {
+	const block &b = blocks[p * nthreads + (p + epoch) % nthreads];
+	worker &wk = workers[p];
+	for (size_t j = 0; j < b.docs.size(); j++) {
+		int m = b.docs[j];
+		size_t i = b.pos[j];
+		pmodel->z.set(i, sampling(wk, m, i));
+	}
+}
+
+/**
+ * Same full conditional as model::sampling. nw[w] and nd[m] are owned by this thread for the epoch, nwsum is
+ * the value at the start of the epoch plus the changes of this thread.
+ */
+int blocklda::sampling(worker &wk, int m, size_t i) {
+	int K = pmodel->K;
+	int topic = pmodel->z.get(i);
+	int w = pmodel->ptrndata->words[i];
+
+	int *nww = pmodel->nw[w];
+	ndcount *ndm = pmodel->nd[m];
+	int *nwsum = pmodel->nwsum;
+	int *dnwsum = wk.dnwsum;
+
+	// remove z_i from the count variables
+	nww[topic] -= 1;
+	ndm[topic] -= 1;
+	dnwsum[topic] -= 1;
+	pmodel->ndsum[m] -= 1;
+
+	double Vbeta = pmodel->V * pmodel->beta;
+	double alpha = pmodel->alpha;
+	double beta = pmodel->beta;
+	double *p = wk.p;
+	// the document denominator (ndsum[m] + K * alpha) is the same for all topics and is left out
+	for (int k = 0; k < K; k++) {
+		p[k] = (nww[k] + beta) / (nwsum[k] + dnwsum[k] + Vbeta) * (ndm[k] + alpha);
+	}
+	for (int k = 1; k < K; k++) {
+		p[k] += p[k - 1];
+	}
+	double u = wk.gen.uniform() * p[K - 1];
+
+	for (topic = 0; topic < K - 1; topic++) {
+		if (p[topic] > u) {
+			break;
+		}
+	}
+
+	// add newly estimated z_i to count variables
+	nww[topic] += 1;
+	ndm[topic] += 1;
+	dnwsum[topic] += 1;
+	pmodel->ndsum[m] += 1;
+
+	return topic;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "PLDA+: Parallel latent Dirichlet allocation with data placement and pipeline processing" by Zhiyuan Liu,
+ *   Yuzhou Zhang, Edward Y. Chang and Maosong Sun (ACM TIST 2011)
+ * + "A new approach to parallel Gibbs sampling for LDA" (diagonal block partitioning) by Feng Yan, Ningyi Xu
+ *   and Yuan Qi (NIPS 2009)
+ */
+
+#ifndef    _BLOCKLDA_H
+#define    _BLOCKLDA_H
+
+#include <vector>
+#include "rng.h"
+
+using namespace std;
+
+class model;
+
+// Parallel Gibbs sampling over a P x P grid of (document range, vocabulary group) blocks
+//
+// An iteration has P epochs. In epoch e thread p samples the words of block (p, (p + e) % P), so no two
+// threads ever share an nd row or an nw row and both are updated in place without locks. Only nwsum is
+// shared; every thread samples against nwsum from the start of the epoch plus its own changes, and the
+// changes are merged after each epoch.
+class blocklda {
+public:
+	blocklda(model *pmodel, int nthreads);
+
+	~blocklda();
+
+	// one Gibbs sweep over all words
+	void iteration();
+
+private:
+	// the words of one block, in document order
+	struct block {
+		vector<int> docs;
+		vector<size_t> pos; // index of the word in the corpus
+	};
+
+	struct worker {
+		int *dnwsum; // changes of nwsum in the current epoch
+		double *p;
+		rng gen; // stream of its own, see model::seed
+	};
+
+	model *pmodel;
+	int nthreads;
+	vector<block> blocks; // block (p, q) is blocks[p * nthreads + q]
+	vector<worker> workers;
+
+	void run(int p, int epoch);
+
+	int sampling(worker &wk, int m, size_t i);
+};
+
+#endif
@@ -31,6 +31,32 @@
 #define    MODEL_STATUS_EST    1
 #define    MODEL_STATUS_ESTC    2
 #define    MODEL_STATUS_INF    3
+#define    MODEL_STATUS_CONVERT    4
+#define    MODEL_STATUS_EXPORT    5
+#define    MODEL_STATUS_TOTEXT    6
+#define    MODEL_STATUS_SERVE    7
+
+#define    SAMPLER_DENSE    0
+#define    SAMPLER_SPARSE    1
+#define    SAMPLER_ALIAS    2
+#define    SAMPLER_GROUPED    3
+
+#define    PARALLEL_ADLDA    0
+#define    PARALLEL_BLOCK    1
+
+#define    KERNEL_AUTO    0
+#define    KERNEL_SCALAR    1
+#define    KERNEL_AVX2    2
+#define    KERNEL_AVX512    3
+
+#define    ORDER_DOC    0
+#define    ORDER_SORTED    1
+#define    ORDER_WORD    2
+
+#define    FORMAT_TEXT    0
+#define    FORMAT_BIN    1
+#define    FORMAT_BIN64    2
+#define    FORMAT_SPARSE    3
 
 #endif
 
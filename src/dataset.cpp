@@ -23,27 +23,59 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <thread>
 #include "constants.h"
-#include "strtokenizer.h"
+#include "viewtokenizer.h"
+#include "mappedfile.h"
+#include "binwriter.h"
+#include "linereader.h"
+#include "utils.h"
 #include "dataset.h"
 
 using namespace std;
 
+/**
+ * Binary corpus layout, all integers in host byte order:
+ *   header
+ *   vocabulary: the V words in id order, each terminated by '\0', padded with '\0' to a multiple of 8 bytes
+ *   offsets: M + 1 uint64 values, document m is words [offsets[m], offsets[m + 1])
+ *   words: ntokens word ids of width bytes each (uint16 if V <= 65536, uint32 otherwise)
+ */
+struct bincorpus_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t width; // bytes per word id
+	uint64_t dsize; // size and modification time of the text corpus it was written from
+	int64_t dmtime;
+	uint64_t wsize; // size and modification time of the word map written with it
+	int64_t wmtime;
+	uint64_t M;
+	uint64_t V;
+	uint64_t ntokens;
+	uint64_t vocabsize; // bytes of the vocabulary, including the padding
+};
+
+static const char bincorpus_magic[8] = {'G', 'L', 'D', 'A', 'C', 'O', 'R', 'P'};
+
 /**
  * Not that these functions are used for serializing and deserializing. Do not write debug information in the write 
  * function if you are also not prepared to adapt the read function.
  */
-int dataset::write_wordmap(const string &wordmapfile, mapword2id *pword2id) {
+int dataset::write_wordmap(const string &wordmapfile, vocabulary *pvocab) {
 	FILE *fout = fopen(wordmapfile.c_str(), "w");
 	if (!fout) {
 		printf("Cannot open file %s to write!\n", wordmapfile.c_str());
 		return 1;
 	}
 
-	mapword2id::iterator it;
-	fprintf(fout, "%zu\n", pword2id->size());
-	for (it = pword2id->begin(); it != pword2id->end(); it++) {
-		fprintf(fout, "%s %d\n", (it->first).c_str(), it->second);
+	vector<int> ids = pvocab->sorted_ids();
+	fprintf(fout, "%zu\n", ids.size());
+	for (int id : ids) {
+		string_view word = pvocab->word(id);
+		fprintf(fout, "%.*s %d\n", (int) word.size(), word.data(), id);
 	}
 
 	fclose(fout);
@@ -51,145 +83,295 @@ int dataset::write_wordmap(const string &wordmapfile, mapword2id *pword2id) {
 	return 0;
 }
 
-int dataset::read_wordmap(const string &wordmapfile, mapword2id *pword2id) {
-	pword2id->clear();
+int dataset::read_wordmap(const string &wordmapfile, vocabulary *pvocab) {
+	pvocab->clear();
 
-	FILE *fin = fopen(wordmapfile.c_str(), "r");
-	if (!fin) {
+	linereader reader;
+	if (reader.open(wordmapfile)) {
 		printf("Cannot open file %s to read!\n", wordmapfile.c_str());
 		return 1;
 	}
 
-	char buff[BUFF_SIZE_SHORT];
-	string line;
-
-	char *endptr = nullptr;
-	fgets(buff, BUFF_SIZE_SHORT - 1, fin);
-	int nwords = (int) strtol(buff, &endptr, 10);
-	//int nwords = atoi(buff);
-
-	for (int i = 0; i < nwords; i++) {
-		fgets(buff, BUFF_SIZE_SHORT - 1, fin);
-		line = buff;
+	string_view line, tokens[2];
+	int nwords = 0;
+	if (reader.next(line) && viewtokenizer(line).next(tokens, 1) == 1) {
+		viewtokenizer::to_int(tokens[0], nwords);
+	}
 
-		strtokenizer strtok(line, " \t\r\n");
-		if (strtok.count_tokens() != 2) {
+	for (int i = 0; i < nwords && reader.next(line); i++) {
+		int id;
+		viewtokenizer strtok(line);
+		if (strtok.next(tokens, 2) != 2 || !viewtokenizer::to_int(tokens[1], id)) {
 			continue;
 		}
 
-		//pword2id->insert(pair<string, int>(strtok.token(0), atoi(strtok.token(1).c_str())));
-		pword2id->insert(pair<string, int>(strtok.token(0), (int) strtol(strtok.token(1).c_str(), &endptr, 10)));
+		pvocab->add(tokens[0], id);
 	}
 
-	fclose(fin);
-
 	return 0;
 }
 
-int dataset::read_wordmap(const string &wordmapfile, mapid2word *pid2word) {
-	pid2word->clear();
+int dataset::read_bincorpus(const string &binfile, const string &dfile, const string &wordmapfile) {
+	uint64_t dsize, wsize;
+	int64_t dmtime, wmtime;
+	if (utils::file_stamp(dfile, &dsize, &dmtime) || utils::file_stamp(wordmapfile, &wsize, &wmtime)) {
+		return 1;
+	}
 
-	FILE *fin = fopen(wordmapfile.c_str(), "r");
-	if (!fin) {
-		printf("Cannot open file %s to read!\n", wordmapfile.c_str());
+	mappedfile bin;
+	if (bin.open(binfile)) {
+		return 1;
+	}
+
+	bincorpus_header header;
+	if (bin.size < sizeof(header)) {
+		return 1;
+	}
+	memcpy(&header, bin.data, sizeof(header));
+	if (memcmp(header.magic, bincorpus_magic, sizeof(bincorpus_magic)) != 0 || header.version != 1 ||
+		(header.width != 2 && header.width != 4)) {
+		printf("Invalid binary corpus %s, ignored!\n", binfile.c_str());
+		return 1;
+	}
+	if (header.dsize != dsize || header.dmtime != dmtime || header.wsize != wsize || header.wmtime != wmtime) {
+		printf("Binary corpus %s is out of date!\n", binfile.c_str());
 		return 1;
+	}
+
+	// the sections one by one, so that no size can wrap around
+	size_t rest = bin.size - sizeof(header);
+	if (header.M == 0 || header.M > (uint64_t) INT32_MAX || header.V == 0 || header.V > (uint64_t) INT32_MAX ||
+		header.vocabsize > rest || (header.M + 1) > (rest - header.vocabsize) / sizeof(uint64_t) ||
+		header.ntokens > (rest - header.vocabsize - (header.M + 1) * sizeof(uint64_t)) / header.width) {
+		printf("Truncated binary corpus %s, ignored!\n", binfile.c_str());
+		return 1;
+	}
+	size_t offsetsat = sizeof(header) + header.vocabsize;
+	size_t wordsat = offsetsat + (header.M + 1) * sizeof(uint64_t);
+
+	deallocate();
+	M = (int) header.M;
+	V = (int) header.V;
+
+	// the offsets and word ids are used as indices later
+	const uint64_t *binoffsets = (const uint64_t *) (bin.data + offsetsat);
+	offsets.assign(binoffsets, binoffsets + M + 1);
+	bool valid = offsets[0] == 0 && offsets[M] == header.ntokens;
+	for (int m = 0; valid && m < M; m++) {
+		valid = offsets[m] <= offsets[m + 1];
+	}
+
+	words.resize(header.ntokens);
+	if (header.width == 2) {
+		const uint16_t *ids = (const uint16_t *) (bin.data + wordsat);
+		for (size_t i = 0; i < words.size(); i++) {
+			words[i] = ids[i];
+		}
 	} else {
-		printf("Opened file %s to read wordmap\n", wordmapfile.c_str());
+		memcpy(words.data(), bin.data + wordsat, words.size() * sizeof(uint32_t));
+	}
+	for (size_t i = 0; valid && i < words.size(); i++) {
+		valid = words[i] >= 0 && words[i] < V;
 	}
 
-	char buff[BUFF_SIZE_SHORT];
-	string line;
+	if (!valid) {
+		printf("Invalid binary corpus %s, ignored!\n", binfile.c_str());
+		deallocate();
+		M = V = 0;
+		return 1;
+	}
 
-	char *endptr = nullptr;
-	fgets(buff, BUFF_SIZE_SHORT - 1, fin);
-	int nwords = (int) strtol(buff, &endptr, 10);
+	return 0;
+}
 
-	for (int i = 0; i < nwords; i++) {
-		fgets(buff, BUFF_SIZE_SHORT - 1, fin);
-		line = buff;
+int dataset::write_bincorpus(const string &binfile, const string &dfile, const string &wordmapfile,
+							 vocabulary *pvocab) {
+	bincorpus_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, bincorpus_magic, sizeof(bincorpus_magic));
+	header.version = 1;
+	header.width = V <= 65536 ? 2 : 4;
+	if (utils::file_stamp(dfile, &header.dsize, &header.dmtime) ||
+		utils::file_stamp(wordmapfile, &header.wsize, &header.wmtime)) {
+		return 1;
+	}
+	header.M = M;
+	header.V = V;
+	header.ntokens = ntokens();
 
-		strtokenizer strtok(line, " \t\r\n");
-		if (strtok.count_tokens() != 2) {
-			continue;
-		}
+	for (int id = 0; id < V; id++) {
+		header.vocabsize += pvocab->word(id).size() + 1;
+	}
+	size_t vocabbytes = header.vocabsize;
+	header.vocabsize = binwriter::padded(vocabbytes);
 
-		pid2word->insert(pair<int, string>((int) strtol(strtok.token(1).c_str(), &endptr, 10), strtok.token(0)));
+	binwriter out;
+	if (out.open(binfile)) {
+		return 1;
 	}
 
-	fclose(fin);
+	out.write(&header, sizeof(header), 1);
+	for (int id = 0; id < V; id++) {
+		string_view word = pvocab->word(id);
+		out.write(word.data(), 1, word.size());
+		out.write("", 1, 1);
+	}
+	out.pad(vocabbytes);
 
-	return 0;
+	for (size_t offset : offsets) {
+		uint64_t value = offset;
+		out.write(&value, sizeof(value), 1);
+	}
+	if (header.width == 2) {
+		vector<uint16_t> ids(words.begin(), words.end());
+		out.write(ids.data(), sizeof(uint16_t), ids.size());
+	} else {
+		out.write(words.data(), sizeof(uint32_t), words.size());
+	}
+
+	return out.commit();
+}
+
+// One newline-aligned piece of the training data, tokenized by a thread of its own
+struct trnchunk {
+	string_view text;
+	vocabulary vocab; // words of the chunk, ids in the order of their first occurrence in the chunk
+	vector<int> words; // chunk ids of the words of all lines
+	vector<int> lengths; // number of words of each line
+	vector<int> global; // corpus id of each chunk id
+	size_t used; // number of words that belong to the first M documents
+	size_t start; // position of the first word of the chunk in the corpus
+};
+
+static void parse_chunk(trnchunk *pchunk) {
+	string_view text = pchunk->text;
+	string_view token;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t stop = text.find('\n', pos);
+		if (stop == string_view::npos) {
+			stop = text.size();
+		}
+
+		viewtokenizer strtok(text.substr(pos, stop - pos));
+		int length = 0;
+		while (strtok.next(token)) {
+			pchunk->words.push_back(pchunk->vocab.insert(token));
+			length++;
+		}
+		pchunk->lengths.push_back(length);
+		pos = stop + 1;
+	}
 }
 
 int dataset::read_trndata(const string &dfile, const string &wordmapfile) {
-	mapword2id word2id;
+	string binfile = dfile + ".bin";
+	if (!read_bincorpus(binfile, dfile, wordmapfile)) {
+		printf("Read the binary corpus %s\n", binfile.c_str());
+		return 0;
+	}
 
-	FILE *fin = fopen(dfile.c_str(), "r");
-	if (!fin) {
+	mappedfile text;
+	if (text.open(dfile)) {
 		printf("Cannot open file %s to read!\n", dfile.c_str());
 		return 1;
 	}
+	string_view data(text.data, text.size);
 
-	mapword2id::iterator it;
-	char buff[BUFF_SIZE_LONG];
-	string line;
-
-	char *endptr = nullptr;
 	// get the number of documents
-	fgets(buff, BUFF_SIZE_LONG - 1, fin);
-	M = (int) strtol(buff, &endptr, 10);
+	size_t body = data.find('\n');
+	string_view token;
+	M = 0;
+	if (viewtokenizer(data.substr(0, body)).next(token)) {
+		viewtokenizer::to_int(token, M);
+	}
 	if (M <= 0) {
 		printf("No document available!\n");
 		return 1;
 	}
+	body = body == string_view::npos ? data.size() : body + 1;
+
+	// split the documents into newline-aligned chunks of at least BUFF_SIZE_LONG bytes, at most one per core
+	size_t nbytes = data.size() - body;
+	int nchunks = (int) min((size_t) max(1u, thread::hardware_concurrency()), nbytes / BUFF_SIZE_LONG + 1);
+	vector<trnchunk> chunks(nchunks);
+	size_t begin = body;
+	for (int c = 0; c < nchunks; c++) {
+		size_t end = data.size();
+		if (c < nchunks - 1) {
+			end = data.find('\n', max(begin, body + nbytes * (c + 1) / nchunks));
+			end = end == string_view::npos ? data.size() : end + 1;
+		}
+		chunks[c].text = data.substr(begin, end - begin);
+		begin = end;
+	}
+
+	// tokenize the chunks in parallel, every chunk numbers its words by itself
+	utils::run_threads(nchunks, [&chunks](int c) {
+		parse_chunk(&chunks[c]);
+	});
 
 	// allocate memory for corpus
-	if (docs) {
-		deallocate();
-	} else {
-		docs = new document *[M];
-	}
+	deallocate();
+	offsets.reserve(M + 1);
+	offsets.push_back(0);
 
 	// set number of words to zero
 	V = 0;
 
-	for (int i = 0; i < M; i++) {
-		// read next line from file
-		fgets(buff, BUFF_SIZE_LONG - 1, fin);
-		line = buff;
-		strtokenizer strtok(line, " \t\r\n");
-
-		// length is number of non-unique words
-		int length = strtok.count_tokens();
-
-		if (length <= 0) {
-			printf("Invalid (empty) document!\n");
-			deallocate();
-			M = V = 0;
-			return 1;
+	// number the words in chunk order, the first occurrences come in the same order as in a sequential read
+	vocabulary word2id;
+	size_t ntokens = 0;
+	int m = 0;
+	for (trnchunk &chunk : chunks) {
+		chunk.start = ntokens;
+		chunk.used = 0;
+		for (size_t j = 0; j < chunk.lengths.size() && m < M; j++, m++) {
+			if (chunk.lengths[j] == 0) {
+				printf("Invalid (empty) document!\n");
+				deallocate();
+				M = V = 0;
+				return 1;
+			}
+			chunk.used += chunk.lengths[j];
+			offsets.push_back(ntokens + chunk.used);
 		}
+		ntokens += chunk.used;
 
-		// allocate new document
-		auto *pdoc = new document(length);
-
-		// iterate over all words found
-		for (int j = 0; j < length; j++) {
-			it = word2id.find(strtok.token(j));
-			if (it == word2id.end()) {
-				// word not found, i.e., new word, add to vocabulary, set its id to vocabulary size
-				pdoc->words[j] = word2id.size();
-				word2id.insert(pair<string, int>(strtok.token(j), word2id.size()));
-			} else {
-				// existing word, set its id in map
-				pdoc->words[j] = it->second;
+		chunk.global.assign(chunk.vocab.size(), -1);
+		if (chunk.used == chunk.words.size()) {
+			// a new word is added to the vocabulary with the vocabulary size as its id
+			for (int id = 0; id < chunk.vocab.size(); id++) {
+				chunk.global[id] = word2id.insert(chunk.vocab.word(id));
+			}
+		} else {
+			// lines after the first M documents, only the words before them count
+			for (size_t i = 0; i < chunk.used; i++) {
+				int id = chunk.words[i];
+				if (chunk.global[id] < 0) {
+					chunk.global[id] = word2id.insert(chunk.vocab.word(id));
+				}
 			}
 		}
+	}
 
-		// add new doc to the corpus
-		add_doc(pdoc, i);
+	// fewer lines than documents, the missing ones are empty
+	if (m < M) {
+		printf("Invalid (empty) document!\n");
+		deallocate();
+		M = V = 0;
+		return 1;
 	}
 
-	fclose(fin);
+	// translate the chunk ids in parallel
+	words.resize(ntokens);
+	utils::run_threads(nchunks, [this, &chunks](int c) {
+		trnchunk &chunk = chunks[c];
+		for (size_t i = 0; i < chunk.used; i++) {
+			words[chunk.start + i] = chunk.global[chunk.words[i]];
+		}
+		vector<int>().swap(chunk.words);
+	});
 
 	// write word map to file
 	if (write_wordmap(wordmapfile, &word2id)) {
@@ -199,179 +381,151 @@ int dataset::read_trndata(const string &dfile, const string &wordmapfile) {
 	// update number of words
 	V = word2id.size();
 
+	// the cache only saves time on later runs, failing to write it is not an error
+	if (!write_bincorpus(binfile, dfile, wordmapfile, &word2id)) {
+		printf("Wrote the binary corpus %s\n", binfile.c_str());
+	}
+
 	return 0;
 }
 
-int dataset::read_newdata(const string &dfile, const string &wordmapfile) {
-	mapword2id word2id;
-	map<int, int> id2_id;
-
-	read_wordmap(wordmapfile, &word2id);
-	if (word2id.empty()) {
+int dataset::read_newdata(const string &dfile, vocabulary *pvocab) {
+	if (pvocab->empty()) {
 		printf("No word map available!\n");
 		return 1;
 	}
 
-	FILE *fin = fopen(dfile.c_str(), "r");
-	if (!fin) {
+	// local id of every word of the word map, -1 until the word is seen in the new data
+	vector<int> id2_id(pvocab->size(), -1);
+	int newV = 0;
+
+	linereader reader;
+	if (reader.open(dfile)) {
 		printf("Cannot open file %s to read!\n", dfile.c_str());
 		return 1;
 	}
 
-	mapword2id::iterator it;
-	map<int, int>::iterator _it;
-	char buff[BUFF_SIZE_LONG];
-	string line;
+	string_view line, token;
 
-	char *endptr = nullptr;
 	// get number of new documents
-	fgets(buff, BUFF_SIZE_LONG - 1, fin);
-	M = (int) strtol(buff, &endptr, 10);
+	M = 0;
+	if (reader.next(line) && viewtokenizer(line).next(token)) {
+		viewtokenizer::to_int(token, M);
+	}
 	if (M <= 0) {
 		printf("No document available!\n");
 		return 1;
 	}
 
 	// allocate memory for corpus
-	if (docs) {
-		deallocate();
-	} else {
-		docs = new document *[M];
-	}
-	_docs = new document *[M];
+	deallocate();
+	offsets.reserve(M + 1);
+	offsets.push_back(0);
 
 	// set number of words to zero
 	V = 0;
 
 	for (int i = 0; i < M; i++) {
-		fgets(buff, BUFF_SIZE_LONG - 1, fin);
-		line = buff;
-		strtokenizer strtok(line, " \t\r\n");
-		int length = strtok.count_tokens();
-
-		vector<int> doc;
-		vector<int> _doc;
-		for (int j = 0; j < length; j++) {
-			it = word2id.find(strtok.token(j));
-			if (it == word2id.end()) {
+		if (!reader.next(line)) {
+			line = string_view();
+		}
+		viewtokenizer strtok(line);
+
+		while (strtok.next(token)) {
+			int id = pvocab->find(token);
+			if (id < 0) {
 				// word not found, i.e., word unseen in training data
 				// do anything? (future decision)
 			} else {
-				int _id;
-				_it = id2_id.find(it->second);
-				if (_it == id2_id.end()) {
-					_id = id2_id.size();
-					id2_id.insert(pair<int, int>(it->second, _id));
-					_id2id.insert(pair<int, int>(_id, it->second));
-				} else {
-					_id = _it->second;
+				if (id2_id[id] < 0) {
+					id2_id[id] = newV++;
+					_id2id.insert(pair<int, int>(id2_id[id], id));
 				}
 
-				doc.push_back(it->second);
-				_doc.push_back(_id);
+				words.push_back(id);
+				_words.push_back(id2_id[id]);
 			}
 		}
 
-		// allocate memory for new doc
-		auto *pdoc = new document(doc);
-		auto *_pdoc = new document(_doc);
-
-		// add new doc
-		add_doc(pdoc, i);
-		_add_doc(_pdoc, i);
+		// close the new doc
+		offsets.push_back(words.size());
 	}
 
-	fclose(fin);
-
 	// update number of new words
-	V = id2_id.size();
+	V = newV;
 
 	return 0;
 }
 
-int dataset::read_newdata_withrawstrs(const string &dfile, const string &wordmapfile) {
-	mapword2id word2id;
-	map<int, int> id2_id;
-
-	read_wordmap(wordmapfile, &word2id);
-	if (word2id.empty()) {
+int dataset::read_newdata_withrawstrs(const string &dfile, vocabulary *pvocab) {
+	if (pvocab->empty()) {
 		printf("No word map available!\n");
 		return 1;
 	}
 
-	FILE *fin = fopen(dfile.c_str(), "r");
-	if (!fin) {
+	// local id of every word of the word map, -1 until the word is seen in the new data
+	vector<int> id2_id(pvocab->size(), -1);
+	int newV = 0;
+
+	linereader reader;
+	if (reader.open(dfile)) {
 		printf("Cannot open file %s to read!\n", dfile.c_str());
 		return 1;
 	}
 
-	mapword2id::iterator it;
-	map<int, int>::iterator _it;
-	char buff[BUFF_SIZE_LONG];
-	string line;
+	string_view line, token;
 
-	char *endptr = nullptr;
 	// get number of new documents
-	fgets(buff, BUFF_SIZE_LONG - 1, fin);
-	M = (int) strtol(buff, &endptr, 10);
+	M = 0;
+	if (reader.next(line) && viewtokenizer(line).next(token)) {
+		viewtokenizer::to_int(token, M);
+	}
 	if (M <= 0) {
 		printf("No document available!\n");
 		return 1;
 	}
 
 	// allocate memory for corpus
-	if (docs) {
-		deallocate();
-	} else {
-		docs = new document *[M];
-	}
-	_docs = new document *[M];
+	deallocate();
+	offsets.reserve(M + 1);
+	offsets.push_back(0);
 
 	// set number of words to zero
 	V = 0;
 
 	for (int i = 0; i < M; i++) {
-		fgets(buff, BUFF_SIZE_LONG - 1, fin);
-		line = buff;
-		strtokenizer strtok(line, " \t\r\n");
-		int length = strtok.count_tokens();
-
-		vector<int> doc;
-		vector<int> _doc;
-		for (int j = 0; j < length - 1; j++) {
-			it = word2id.find(strtok.token(j));
-			if (it == word2id.end()) {
+		if (!reader.next(line)) {
+			line = string_view();
+		}
+		viewtokenizer strtok(line);
+
+		// the last token of the line is not a word, so every token is looked up when the next one is found
+		string_view next;
+		bool more = strtok.next(token);
+		while (more && (more = strtok.next(next))) {
+			int id = pvocab->find(token);
+			if (id < 0) {
 				// word not found, i.e., word unseen in training data
 				// do anything? (future decision)
 			} else {
-				int _id;
-				_it = id2_id.find(it->second);
-				if (_it == id2_id.end()) {
-					_id = id2_id.size();
-					id2_id.insert(pair<int, int>(it->second, _id));
-					_id2id.insert(pair<int, int>(_id, it->second));
-				} else {
-					_id = _it->second;
+				if (id2_id[id] < 0) {
+					id2_id[id] = newV++;
+					_id2id.insert(pair<int, int>(id2_id[id], id));
 				}
 
-				doc.push_back(it->second);
-				_doc.push_back(_id);
+				words.push_back(id);
+				_words.push_back(id2_id[id]);
 			}
+			token = next;
 		}
 
-		// allocate memory for new doc
-		auto *pdoc = new document(doc, line);
-		auto *_pdoc = new document(_doc, line);
-
-		// add new doc
-		add_doc(pdoc, i);
-		_add_doc(_pdoc, i);
+		// close the new doc and keep its raw string
+		offsets.push_back(words.size());
+		rawstrs.push_back(string(line));
 	}
 
-	fclose(fin);
-
 	// update number of new words
-	V = id2_id.size();
+	V = newV;
 
 	return 0;
 }
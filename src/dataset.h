@@ -27,152 +27,70 @@
 #include <string>
 #include <vector>
 #include <map>
+#include "vocabulary.h"
 
 using namespace std;
 
-// map of words/terms [string => int]
-typedef map<string, int> mapword2id;
-// map of words/terms [int => string]
-typedef map<int, string> mapid2word;
-
-class document {
-public:
-	int *words;
-	string rawstr;
-	int length;
-
-	document() {
-		words = nullptr;
-		rawstr = "";
-		length = 0;
-	}
-
-	explicit document(int length) {
-		this->length = length;
-		rawstr = "";
-		words = new int[length];
-	}
-
-	document(int length, const int *words) {
-		this->length = length;
-		rawstr = "";
-		this->words = new int[length];
-		for (int i = 0; i < length; i++) {
-			this->words[i] = words[i];
-		}
-	}
-
-	document(int length, const int *words, const string &rawstr) {
-		this->length = length;
-		this->rawstr = rawstr;
-		this->words = new int[length];
-		for (int i = 0; i < length; i++) {
-			this->words[i] = words[i];
-		}
-	}
-
-	explicit document(vector<int> &doc) {
-		this->length = doc.size();
-		rawstr = "";
-		this->words = new int[length];
-		for (int i = 0; i < length; i++) {
-			this->words[i] = doc[i];
-		}
-	}
-
-	document(vector<int> &doc, const string &rawstr) {
-		this->length = doc.size();
-		this->rawstr = rawstr;
-		this->words = new int[length];
-		for (int i = 0; i < length; i++) {
-			this->words[i] = doc[i];
-		}
-	}
-
-	~document() {
-		delete words;
-	}
-};
-
+// The corpus is stored in compressed sparse row form: the word ids of all documents lie back to back in words and
+// document m occupies words[offsets[m]] .. words[offsets[m + 1] - 1]. Token i of the corpus is addressed by the same
+// global index in words, _words and the topic assignments of the model.
 class dataset {
 public:
-	document **docs;
-	document **_docs; // used only for inference
+	vector<int> words; // word ids of all documents
+	vector<int> _words; // local word ids, parallel to words, used only for inference
+	vector<size_t> offsets; // start of each document in words, M + 1 entries
+	vector<string> rawstrs; // raw document lines, used only for inference with raw strings
 	map<int, int> _id2id; // also used only for inference
 	int M; // number of documents
 	int V; // number of words
 
 	dataset() {
-		docs = nullptr;
-		_docs = nullptr;
 		M = 0;
 		V = 0;
 	}
 
-	explicit dataset(int M) {
-		this->M = M;
-		this->V = 0;
-		docs = new document *[M];
-		_docs = nullptr;
+	// number of words in document m
+	int length(int m) const {
+		return (int) (offsets[m + 1] - offsets[m]);
 	}
 
-	~dataset() {
-		if (docs) {
-			for (int i = 0; i < M; i++) {
-				delete docs[i];
-			}
-		}
-		delete docs;
-
-		if (_docs) {
-			for (int i = 0; i < M; i++) {
-				delete _docs[i];
-			}
-		}
-		delete _docs;
+	// word ids of document m
+	const int *doc(int m) const {
+		return words.data() + offsets[m];
 	}
 
-	void deallocate() {
-		if (docs) {
-			for (int i = 0; i < M; i++) {
-				delete docs[i];
-			}
-		}
-		delete docs;
-		docs = nullptr;
-
-		if (_docs) {
-			for (int i = 0; i < M; i++) {
-				delete _docs[i];
-			}
-		}
-		delete _docs;
-		_docs = nullptr;
+	// total number of words in the corpus
+	size_t ntokens() const {
+		return offsets.empty() ? 0 : offsets.back();
 	}
 
-	void add_doc(document *doc, int idx) {
-		if (0 <= idx && idx < M) {
-			docs[idx] = doc;
-		}
+	void deallocate() {
+		vector<int>().swap(words);
+		vector<int>().swap(_words);
+		vector<size_t>().swap(offsets);
+		vector<string>().swap(rawstrs);
 	}
 
-	void _add_doc(document *doc, int idx) {
-		if (0 <= idx && idx < M) {
-			_docs[idx] = doc;
-		}
-	}
+	// the word map lists the words in lexicographic order
+	static int write_wordmap(const string &wordmapfile, vocabulary *pvocab);
 
-	static int write_wordmap(const string &wordmapfile, mapword2id *pword2id);
+	static int read_wordmap(const string &wordmapfile, vocabulary *pvocab);
 
-	static int read_wordmap(const string &wordmapfile, mapword2id *pword2id);
+	// reads the binary corpus dfile + ".bin" if it is up to date, otherwise tokenizes dfile and writes the
+	// word map and the binary corpus for the next run
+	int read_trndata(const string &dfile, const string &wordmapfile);
 
-	static int read_wordmap(const string &wordmapfile, mapid2word *pid2word);
+	// load a binary corpus, returns 1 if it is missing or was not written from the current dfile and wordmapfile
+	int read_bincorpus(const string &binfile, const string &dfile, const string &wordmapfile);
 
-	int read_trndata(const string &dfile, const string &wordmapfile);
+	// write the corpus with its vocabulary and the size and modification time of dfile and wordmapfile
+	int write_bincorpus(const string &binfile, const string &dfile, const string &wordmapfile,
+						vocabulary *pvocab);
 
-	int read_newdata(const string &dfile, const string &wordmapfile);
+	// read new data, keeping the words of the training vocabulary pvocab
+	int read_newdata(const string &dfile, vocabulary *pvocab);
 
-	int read_newdata_withrawstrs(const string &dfile, const string &wordmapfile);
+	int read_newdata_withrawstrs(const string &dfile, vocabulary *pvocab);
 };
 
 #endif
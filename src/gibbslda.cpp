@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <limits>
+#include <vector>
+#include "model.h"
+#include "utils.h"
+#include "gibbslda.h"
+
+using namespace std;
+
+gibbslda::gibbslda() {
+	pmodel = nullptr;
+	verbose = false;
+}
+
+gibbslda::~gibbslda() {
+	delete pmodel;
+}
+
+void gibbslda::set_verbose(bool on) {
+	verbose = on;
+}
+
+void gibbslda::reset() {
+	delete pmodel;
+	pmodel = new model;
+	pmodel->verbose = verbose;
+}
+
+int gibbslda::init(int argc, char **argv) {
+	reset();
+	return pmodel->init(argc, argv);
+}
+
+int gibbslda::run() {
+	if (!pmodel) {
+		return 1;
+	}
+
+	int status = pmodel->model_status;
+	if (status == MODEL_STATUS_EST || status == MODEL_STATUS_ESTC) {
+		// parameter estimation
+		pmodel->estimate();
+	} else if (status == MODEL_STATUS_INF) {
+		// do inference
+		pmodel->inference();
+	} else if (status == MODEL_STATUS_SERVE) {
+		// answer documents until the input ends
+		return pmodel->serve();
+	}
+
+	return 0;
+}
+
+int gibbslda::load(const string &dir, const string &model_name) {
+	reset();
+
+	pmodel->dir = dir;
+	if (pmodel->dir.empty() || pmodel->dir[pmodel->dir.size() - 1] != '/') {
+		pmodel->dir += "/";
+	}
+	pmodel->model_name = model_name;
+
+	if (pmodel->read_inf_others()) {
+		return 1;
+	}
+	if (pmodel->load_inf_counts()) {
+		return 1;
+	}
+
+	init_infer();
+
+	return 0;
+}
+
+int gibbslda::load(const char *data, size_t size) {
+	reset();
+
+	if (pmodel->load_infmodel(data, size, "(memory)")) {
+		return 1;
+	}
+
+	init_infer();
+
+	return 0;
+}
+
+int gibbslda::train(const int *words, const size_t *offsets, int M, int V, const options &opts) {
+	reset();
+
+	if (M <= 0 || V <= 0 || opts.K <= 0) {
+		printf("Cannot train a model of %d documents, %d words and %d topics!\n", M, V, opts.K);
+		return 1;
+	}
+	for (int m = 0; m < M; m++) {
+		if (offsets[m + 1] < offsets[m]) {
+			printf("Invalid offsets of document %d!\n", m);
+			return 1;
+		}
+	}
+
+	dataset *pdata = new dataset;
+	pmodel->ptrndata = pdata;
+	pdata->M = M;
+	pdata->V = V;
+	pdata->offsets.assign(offsets, offsets + M + 1);
+	pdata->words.assign(words + offsets[0], words + offsets[M]);
+	if (offsets[0] != 0) {
+		for (auto &offset : pdata->offsets) {
+			offset -= offsets[0];
+		}
+	}
+	for (int w : pdata->words) {
+		if (w < 0 || w >= V) {
+			printf("Word id %d is not below %d!\n", w, V);
+			return 1;
+		}
+	}
+	if (pmodel->check_ndcount(pdata)) {
+		return 1;
+	}
+
+	pmodel->model_status = MODEL_STATUS_EST;
+	pmodel->M = M;
+	pmodel->V = V;
+	pmodel->K = opts.K;
+	pmodel->alpha = opts.alpha >= 0.0 ? opts.alpha : 50.0 / opts.K;
+	pmodel->beta = opts.beta;
+	pmodel->niters = opts.niters;
+	pmodel->savestep = 0;
+	pmodel->sampler = opts.sampler;
+	pmodel->mhsteps = opts.mhsteps;
+	pmodel->nthreads = opts.nthreads;
+	pmodel->parallel = opts.parallel;
+	pmodel->kerneltype = opts.kerneltype;
+	pmodel->seed = opts.seed;
+	pmodel->generator = rng(opts.seed, 0);
+
+	pmodel->init_est_corpus();
+	pmodel->sample_iterations();
+	pmodel->compute_theta();
+	pmodel->compute_phi();
+
+	init_infer();
+
+	return 0;
+}
+
+void gibbslda::init_infer() {
+	if (!pmodel->pkernel) {
+		pmodel->select_kernel();
+	}
+	pmodel->init_fixed();
+}
+
+int gibbslda::infer(const int *words, size_t n, double *theta, int niters, uint64_t seed) const {
+	if (!pmodel) {
+		return 1;
+	}
+	int K = pmodel->K;
+	if (n > (size_t) numeric_limits<ndcount>::max()) {
+		return 1;
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (words[i] < 0 || words[i] >= pmodel->V) {
+			return 1;
+		}
+	}
+
+	// a generator of its own, so that calls do not depend on each other
+	uint64_t key = seed;
+	rng gen(splitmix64(key));
+	vector<int> topics(n);
+	vector<ndcount> nd(K, 0);
+	for (size_t i = 0; i < n; i++) {
+		topics[i] = gen.below(K);
+		nd[topics[i]] += 1;
+	}
+
+	vector<double> pp(K);
+	pmodel->sample_fixed(words, topics.data(), n, nd.data(), niters, gen, pp.data());
+
+	for (int k = 0; k < K; k++) {
+		theta[k] = (nd[k] + pmodel->alpha) / (n + K * pmodel->alpha);
+	}
+
+	return 0;
+}
+
+int gibbslda::save(const string &dir, const string &model_name) {
+	if (!pmodel || !pmodel->ptrndata) {
+		printf("There is no trained model to save!\n");
+		return 1;
+	}
+	pmodel->dir = dir;
+	if (pmodel->dir.empty() || pmodel->dir[pmodel->dir.size() - 1] != '/') {
+		pmodel->dir += "/";
+	}
+
+	return pmodel->save_model(model_name);
+}
+
+int gibbslda::ntopics() const {
+	return pmodel ? pmodel->K : 0;
+}
+
+int gibbslda::nwords() const {
+	return pmodel ? pmodel->V : 0;
+}
+
+int gibbslda::word_id(string_view word) const {
+	return pmodel ? pmodel->id2word.find(word) : -1;
+}
+
+const double *gibbslda::theta(int m) const {
+	if (!pmodel || !pmodel->ptrndata || m < 0 || m >= pmodel->M) {
+		return nullptr;
+	}
+	return pmodel->theta[m];
+}
+
+const double *gibbslda::phi(int k) const {
+	if (!pmodel || !pmodel->ptrndata || k < 0 || k >= pmodel->K) {
+		return nullptr;
+	}
+	return pmodel->phi[k];
+}
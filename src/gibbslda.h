@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _GIBBSLDA_H
+#define    _GIBBSLDA_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "constants.h"
+
+using namespace std;
+
+class model;
+
+// In-process interface of the library: load a model from its files or from memory, infer the topics of documents
+// given as word ids and estimate a model from a corpus in memory, without going through the files of lda.
+// Every load and train starts over with a new model. The functions return 0 on success and 1 on failure, the
+// reason is printed like lda does. Progress and status messages are only printed after set_verbose(true).
+class gibbslda {
+public:
+	// estimation options, the defaults are those of lda -est
+	struct options {
+		int K = 100;
+		double alpha = -1.0; // default 50 / K
+		double beta = 0.1;
+		int niters = 2000;
+		int sampler = SAMPLER_DENSE;
+		int mhsteps = 2;
+		int nthreads = 1;
+		int parallel = PARALLEL_ADLDA;
+		int kerneltype = KERNEL_AUTO;
+		uint64_t seed = 0;
+	};
+
+	gibbslda();
+
+	~gibbslda();
+
+	gibbslda(const gibbslda &) = delete;
+
+	gibbslda &operator=(const gibbslda &) = delete;
+
+	// print progress and status messages to stdout, like lda does, for the models loaded or trained afterwards
+	void set_verbose(bool on);
+
+	// the lda command line: parse the arguments and read what their mode needs, returns 1 for a usage error
+	int init(int argc, char **argv);
+
+	// then estimate, infer or serve as the command line asked for, returns the exit status
+	int run();
+
+	// load model_name in dir the way lda -inf does: the inference export (lda -export), the checkpoint or the
+	// .tassign and .others files, and the word map
+	int load(const string &dir, const string &model_name);
+
+	// load an inference export from memory, e.g. a mapped <model>.infmodel, which is not used after the call
+	int load(const char *data, size_t size);
+
+	// estimate a model from the M documents words[offsets[m]] .. words[offsets[m + 1] - 1], word ids below V;
+	// afterwards theta, phi and infer are those of the new model
+	int train(const int *words, const size_t *offsets, int M, int V, const options &opts);
+
+	// theta of the document words[0] .. words[n - 1] after niters iterations with the fixed model, into
+	// theta[0] .. theta[K - 1], by Metropolis-Hastings if the model was trained with SAMPLER_ALIAS (see
+	// aliasinf); the same words and seed give the same theta. Safe to call from several threads
+	// at once, returns 1 if a word id is not below V or the document is too long
+	int infer(const int *words, size_t n, double *theta, int niters = 20, uint64_t seed = 0) const;
+
+	// write the trained model to dir like lda -est does, model_name.tassign, .theta, .phi, .others and .ckpt
+	int save(const string &dir, const string &model_name);
+
+	int ntopics() const;
+
+	int nwords() const;
+
+	// id of word in the loaded model, -1 if it is unknown or the model has no word map
+	int word_id(string_view word) const;
+
+	// row m of theta and row k of phi of the trained model, nullptr if there is none (e.g. after load) or the
+	// index is out of range
+	const double *theta(int m) const;
+
+	const double *phi(int k) const;
+
+private:
+	model *pmodel;
+	bool verbose;
+
+	// a new model in place of the current one
+	void reset();
+
+	// with nw and nwsum in place, get ready for infer
+	void init_infer();
+};
+
+#endif
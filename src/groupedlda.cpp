@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include "dataset.h"
+#include "model.h"
+#include "groupedlda.h"
+
+using namespace std;
+
+groupedlda::groupedlda(model *pmodel) {
+	this->pmodel = pmodel;
+	K = pmodel->K;
+	alpha = pmodel->alpha;
+	beta = pmodel->beta;
+	Vbeta = pmodel->V * beta;
+
+	changed.reserve(max_changed + 2);
+	delta.reserve(max_changed + 2);
+
+	// report how much of the corpus the groups cover
+	dataset *pdata = pmodel->ptrndata;
+	size_t ngroups = 0, ngrouped = 0;
+	for (int m = 0; m < pdata->M; m++) {
+		size_t end = pdata->offsets[m + 1];
+		for (size_t i = pdata->offsets[m]; i < end;) {
+			size_t j = i + 1;
+			while (j < end && pdata->words[j] == pdata->words[i]) {
+				j++;
+			}
+			if (j - i > 1) {
+				ngroups++;
+				ngrouped += j - i;
+			}
+			i = j;
+		}
+	}
+	if (pmodel->verbose) {
+		printf("Grouped sampler: %zu groups of repeated words hold %.1f%% of the words\n", ngroups,
+			   pdata->ntokens() > 0 ? 100.0 * ngrouped / pdata->ntokens() : 0.0);
+	}
+}
+
+void groupedlda::sample_doc(int m) {
+	dataset *pdata = pmodel->ptrndata;
+	size_t end = pdata->offsets[m + 1];
+	for (size_t i = pdata->offsets[m]; i < end;) {
+		int w = pdata->words[i];
+		size_t j = i + 1;
+		while (j < end && pdata->words[j] == w) {
+			j++;
+		}
+		sample_group(m, w, i, j);
+		i = j;
+	}
+}
+
+void groupedlda::sample_group(int m, int w, size_t first, size_t last) {
+	int *nww = pmodel->nw[w];
+	ndcount *ndm = pmodel->nd[m];
+	int *nwsum = pmodel->nwsum;
+	double *invsum = pmodel->invsum;
+
+	for (size_t i = first; i < last; i++) {
+		// remove z_i from the count variables
+		int topic = pmodel->z.get(i);
+		nww[topic] -= 1;
+		ndm[topic] -= 1;
+		nwsum[topic] -= 1;
+		pmodel->ndsum[m] -= 1;
+		invsum[topic] = 1.0 / (nwsum[topic] + Vbeta);
+
+		if (i == first || changed.size() >= max_changed) {
+			topic = pmodel->pkernel(nww, nullptr, ndm, invsum, K, alpha, beta, pmodel->generator.uniform(), pmodel->p);
+			changed.clear();
+		} else {
+			mark(topic);
+			topic = draw(nww, ndm, pmodel->generator.uniform());
+		}
+
+		// add newly estimated z_i to count variables
+		nww[topic] += 1;
+		ndm[topic] += 1;
+		nwsum[topic] += 1;
+		pmodel->ndsum[m] += 1;
+		invsum[topic] = 1.0 / (nwsum[topic] + Vbeta);
+		mark(topic);
+
+		pmodel->z.set(i, topic);
+	}
+}
+
+void groupedlda::mark(int k) {
+	auto it = lower_bound(changed.begin(), changed.end(), k);
+	if (it == changed.end() || *it != k) {
+		changed.insert(it, k);
+	}
+}
+
+int groupedlda::draw(const int *nww, const ndcount *ndm, double u) {
+	const double *p = pmodel->p;
+	const double *invsum = pmodel->invsum;
+
+	double total = p[K - 1];
+	delta.resize(changed.size());
+	for (size_t j = 0; j < changed.size(); j++) {
+		int k = changed[j];
+		double cumulated = p[k] - (k > 0 ? p[k - 1] : 0.0);
+		delta[j] = (nww[k] + beta) * (ndm[k] + alpha) * invsum[k] - cumulated;
+		total += delta[j];
+	}
+
+	// between two changed topics the corrected cumulated weights are p[k] + offset
+	double x = u * total;
+	double offset = 0.0;
+	int lo = 0;
+	for (size_t j = 0; j < changed.size(); j++) {
+		int k = changed[j];
+		if (lo < k && p[k - 1] + offset > x) {
+			return (int) (upper_bound(p + lo, p + k, x - offset) - p);
+		}
+		offset += delta[j];
+		if (p[k] + offset > x) {
+			return k;
+		}
+		lo = k + 1;
+	}
+	if (lo < K && p[K - 1] + offset > x) {
+		return (int) (upper_bound(p + lo, p + K, x - offset) - p);
+	}
+
+	// rounding can push x past the last topic
+	return K - 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _GROUPEDLDA_H
+#define    _GROUPEDLDA_H
+
+#include <cstddef>
+#include <vector>
+#include "matrix.h"
+
+using namespace std;
+
+class model;
+
+// Sampler for bag-of-words documents with repeated words
+//
+// The words of every document are sorted by word id (see ORDER_SORTED), so the c occurrences of a word w in
+// document m form one group of consecutive corpus indices whose z values are the topic histogram of the group.
+// All occurrences of a group share the word-dependent terms of
+//   p(k) ~ (nw[w][k] + beta) * (nd[m][k] + alpha) / (nwsum[k] + Vbeta)
+// and resampling one occurrence only changes the weights of its old and its new topic. The first occurrence
+// is drawn with the dense kernel, which leaves the cumulated weights in model::p. The following ones are drawn
+// from that cumulated array plus the exact weight changes of the few topics touched since, by a binary search
+// per unchanged stretch of topics. A group costs about one kernel call instead of c of them and the draws are
+// exact collapsed Gibbs updates in the same order as the dense sampler.
+class groupedlda {
+public:
+	explicit groupedlda(model *pmodel);
+
+	// resample all words of document m, updates z and the count variables
+	void sample_doc(int m);
+
+private:
+	// number of touched topics after which the cumulated weights are recomputed by the kernel
+	static const size_t max_changed = 16;
+
+	model *pmodel;
+	int K;
+	double alpha, beta, Vbeta;
+
+	vector<int> changed; // topics whose counts changed since the last kernel call, ascending
+	vector<double> delta; // current minus cumulated weight of each topic in changed
+
+	// resample the occurrences [first, last) of word w in document m
+	void sample_group(int m, int w, size_t first, size_t last);
+
+	// add topic k to changed
+	void mark(int k);
+
+	// draw from the cumulated weights in model::p corrected by the changed topics, u is uniform in [0, 1)
+	int draw(const int *nww, const ndcount *ndm, double u);
+};
+
+#endif
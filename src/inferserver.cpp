@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "viewtokenizer.h"
+#include "linereader.h"
+#include "textwriter.h"
+#include "model.h"
+#include "inferserver.h"
+
+using namespace std;
+
+// at most this many documents of one stream are read ahead of its answers
+static const size_t max_pending = 1024;
+
+// report the latency after every this many documents
+static const size_t report_step = 10000;
+
+// latency buckets: 16 per doubling from 1 microsecond, about 4.4% wide, the last one also holds everything above
+// 2^28 microseconds (4.5 minutes)
+static const int buckets_per_doubling = 16;
+static const int nbuckets = 28 * buckets_per_doubling + 1;
+
+static int latency_bucket(double secs) {
+	double micros = secs * 1e6;
+	if (micros <= 1.0) {
+		return 0;
+	}
+	return min((int) (log2(micros) * buckets_per_doubling) + 1, nbuckets - 1);
+}
+
+// upper end of bucket b in seconds
+static double bucket_limit(int b) {
+	return exp2((double) b / buckets_per_doubling) * 1e-6;
+}
+
+static volatile sig_atomic_t stop_signal = 0;
+
+static void on_stop_signal(int) {
+	stop_signal = 1;
+}
+
+// write all of text to fd, returns 1 if the other end is gone
+static int write_all(int fd, const char *text, size_t size) {
+	while (size > 0) {
+		ssize_t n = write(fd, text, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		text += n;
+		size -= n;
+	}
+	return 0;
+}
+
+// FNV-1a, so that the same document gets the same answer
+static uint64_t doc_hash(const string &doc) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : doc) {
+		hash = (hash ^ c) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+inferserver::inferserver(model *pmodel, int nworkers, int ntop, int maxbatch, double window) {
+	this->pmodel = pmodel;
+	this->ntop = min(ntop, pmodel->K);
+	this->maxbatch = max(maxbatch, 1);
+	this->window = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(window));
+	this->nworkers = nworkers;
+	busy = 0;
+	stopping = false;
+	nbatches = 0;
+	histogram.assign(nbuckets, 0);
+	answered = 0;
+	// a reader that goes away shows up as a failed write
+	signal(SIGPIPE, SIG_IGN);
+	for (int t = 0; t < nworkers; t++) {
+		workers.emplace_back(&inferserver::work, this);
+	}
+}
+
+inferserver::~inferserver() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	ready.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void inferserver::work() {
+	vector<shared_ptr<request> > batch;
+	vector<job> jobs(maxbatch);
+	vector<token> tokens;
+	vector<double> pp(pmodel->K);
+	while (true) {
+		{
+			unique_lock<mutex> guard(lock);
+			ready.wait(guard, [this]() {
+				return stopping || !queue.empty();
+			});
+			if (queue.empty()) {
+				return;
+			}
+			// the batch is full or its oldest document has waited long enough
+			ready.wait_until(guard, queue.front()->arrival + window, [this]() {
+				return stopping || queue.size() >= maxbatch;
+			});
+			if (queue.empty()) {
+				// another worker took them
+				continue;
+			}
+			size_t idle = nworkers - busy;
+			size_t n = min(maxbatch, (queue.size() + idle - 1) / idle);
+			busy++;
+			batch.assign(queue.begin(), queue.begin() + n);
+			queue.erase(queue.begin(), queue.begin() + n);
+		}
+		{
+			// counted before any of its answers, so that a report covers the batches of its documents
+			lock_guard<mutex> guard(statslock);
+			nbatches++;
+		}
+
+		tokens.clear();
+		for (size_t j = 0; j < batch.size(); j++) {
+			if (prepare(*batch[j], jobs[j])) {
+				for (size_t i = 0; i < jobs[j].words.size(); i++) {
+					tokens.push_back({jobs[j].words[i], (int) j, (int) i});
+				}
+			}
+		}
+		// word-major over the batch, so the nw row of a word is read once per iteration for all its documents;
+		// stable, so every document still sees its own (sorted) words in order and its answer does not depend
+		// on the rest of the batch
+		stable_sort(tokens.begin(), tokens.end(), [](const token &a, const token &b) {
+			return a.word < b.word;
+		});
+		for (int iter = 0; iter < pmodel->niters; iter++) {
+			for (const token &t : tokens) {
+				job &jb = jobs[t.job];
+				int topic = jb.topics[t.pos];
+				jb.nd[topic] -= 1;
+				topic = pmodel->draw_fixed(t.word, topic, jb.nd.data(), jb.topics.data(), jb.topics.size(), jb.gen,
+										   pp.data());
+				jb.nd[topic] += 1;
+				jb.topics[t.pos] = topic;
+			}
+		}
+
+		for (size_t j = 0; j < batch.size(); j++) {
+			request &req = *batch[j];
+			if (req.answer.empty()) {
+				finish(req, jobs[j], pp);
+			}
+			// notified under the lock, the stream may be gone as soon as it is released
+			stream *owner = req.owner;
+			lock_guard<mutex> guard(owner->lock);
+			req.done = true;
+			owner->changed.notify_all();
+		}
+		batch.clear();
+		{
+			lock_guard<mutex> guard(lock);
+			busy--;
+		}
+	}
+}
+
+bool inferserver::prepare(request &req, job &jb) {
+	int K = pmodel->K;
+
+	jb.words.clear();
+	viewtokenizer strtok(req.doc);
+	string_view token;
+	while (strtok.next(token)) {
+		// words that are not in the model are skipped
+		int id = pmodel->id2word.find(token);
+		if (id >= 0) {
+			jb.words.push_back(id);
+		}
+	}
+	if (jb.words.size() > (size_t) numeric_limits<ndcount>::max()) {
+		req.answer = "error: document too long\n";
+		return false;
+	}
+	// the order of the words does not matter to the model, sorted they can be sampled word-major
+	sort(jb.words.begin(), jb.words.end());
+
+	size_t n = jb.words.size();
+	uint64_t key = pmodel->seed ^ doc_hash(req.doc);
+	jb.gen = rng(splitmix64(key));
+	jb.topics.resize(n);
+	jb.nd.assign(K, 0);
+	for (size_t i = 0; i < n; i++) {
+		jb.topics[i] = jb.gen.below(K);
+		jb.nd[jb.topics[i]] += 1;
+	}
+	return true;
+}
+
+void inferserver::finish(request &req, const job &jb, vector<double> &pp) {
+	int K = pmodel->K;
+	double alpha = pmodel->alpha;
+	size_t n = jb.words.size();
+
+	for (int k = 0; k < K; k++) {
+		pp[k] = (jb.nd[k] + alpha) / (n + K * alpha);
+	}
+	vector<int> order(K);
+	for (int k = 0; k < K; k++) {
+		order[k] = k;
+	}
+	partial_sort(order.begin(), order.begin() + ntop, order.end(), [&pp](int a, int b) {
+		return pp[a] > pp[b] || (pp[a] == pp[b] && a < b);
+	});
+
+	textbuffer out;
+	for (int j = 0; j < ntop; j++) {
+		out.put(order[j]);
+		out.put(':');
+		out.put(pp[order[j]]);
+		out.put(' ');
+	}
+	out.put('|');
+	for (int k = 0; k < K; k++) {
+		out.put(' ');
+		out.put(pp[k]);
+	}
+	out.put('\n');
+	req.answer.assign(out.data.data(), out.size);
+}
+
+int inferserver::serve_stream(FILE *in, int outfd) {
+	stream st;
+	st.closed = false;
+
+	// answers leave in input order, as soon as the oldest document is done
+	int failed = 0;
+	thread writer([this, &st, outfd, &failed]() {
+		unique_lock<mutex> guard(st.lock);
+		while (true) {
+			st.changed.wait(guard, [&st]() {
+				return (!st.pending.empty() && st.pending.front()->done) || (st.closed && st.pending.empty());
+			});
+			if (st.pending.empty()) {
+				return;
+			}
+			shared_ptr<request> req = st.pending.front();
+			st.pending.pop_front();
+			guard.unlock();
+			st.changed.notify_all();
+
+			if (!failed && write_all(outfd, req->answer.data(), req->answer.size())) {
+				failed = 1;
+			}
+			record(req->arrival);
+			guard.lock();
+		}
+	});
+
+	linereader reader;
+	reader.open(in);
+	string_view line;
+	while (reader.next(line)) {
+		auto req = make_shared<request>();
+		req->doc.assign(line.data(), line.size());
+		req->done = false;
+		req->owner = &st;
+		req->arrival = chrono::steady_clock::now();
+		{
+			unique_lock<mutex> guard(st.lock);
+			st.changed.wait(guard, [&st]() {
+				return st.pending.size() < max_pending;
+			});
+			st.pending.push_back(req);
+		}
+		{
+			lock_guard<mutex> guard(lock);
+			queue.push_back(req);
+		}
+		ready.notify_one();
+	}
+
+	{
+		lock_guard<mutex> guard(st.lock);
+		st.closed = true;
+	}
+	st.changed.notify_all();
+	writer.join();
+
+	return failed;
+}
+
+int inferserver::serve_socket(const string &path) {
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		printf("Socket path %s is too long!\n", path.c_str());
+		return 1;
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size());
+
+	int listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenfd < 0) {
+		printf("Cannot create a socket!\n");
+		return 1;
+	}
+	unlink(path.c_str());
+	if (bind(listenfd, (const sockaddr *) &addr, sizeof(addr)) != 0 || listen(listenfd, 64) != 0) {
+		printf("Cannot listen on %s!\n", path.c_str());
+		close(listenfd);
+		return 1;
+	}
+
+	signal(SIGINT, on_stop_signal);
+	signal(SIGTERM, on_stop_signal);
+	printf("Serving on %s\n", path.c_str());
+	fflush(stdout);
+
+	// every connection runs on a thread of its own, they are told to stop by shutting down their input
+	mutex connlock;
+	condition_variable connchanged;
+	set<int> connections;
+	while (!stop_signal) {
+		pollfd pfd = {listenfd, POLLIN, 0};
+		if (poll(&pfd, 1, 200) <= 0) {
+			continue;
+		}
+		int fd = accept(listenfd, nullptr, nullptr);
+		if (fd < 0) {
+			continue;
+		}
+
+		{
+			lock_guard<mutex> guard(connlock);
+			connections.insert(fd);
+		}
+		thread([this, fd, &connlock, &connchanged, &connections]() {
+			FILE *in = fdopen(fd, "r");
+			if (in) {
+				serve_stream(in, fd);
+				fclose(in);
+			} else {
+				close(fd);
+			}
+			lock_guard<mutex> guard(connlock);
+			connections.erase(fd);
+			connchanged.notify_all();
+		}).detach();
+	}
+
+	close(listenfd);
+	unlink(path.c_str());
+
+	unique_lock<mutex> guard(connlock);
+	for (int fd : connections) {
+		shutdown(fd, SHUT_RD);
+	}
+	connchanged.wait(guard, [&connections]() {
+		return connections.empty();
+	});
+
+	return 0;
+}
+
+void inferserver::record(chrono::steady_clock::time_point arrival) {
+	auto now = chrono::steady_clock::now();
+	lock_guard<mutex> guard(statslock);
+	if (answered == 0 || arrival < first) {
+		first = arrival;
+	}
+	last = now;
+	histogram[latency_bucket(chrono::duration<double>(now - arrival).count())]++;
+	answered++;
+	if (answered % report_step == 0) {
+		print_latency();
+	}
+}
+
+void inferserver::report() {
+	lock_guard<mutex> guard(statslock);
+	print_latency();
+}
+
+void inferserver::print_latency() {
+	if (answered == 0) {
+		fprintf(stderr, "No documents answered\n");
+		return;
+	}
+	double secs = chrono::duration<double>(last - first).count();
+	fprintf(stderr, "%llu documents in %zu batches (%.1f per batch), %.0f documents/sec, "
+			"latency p50 %.3f ms, p99 %.3f ms\n", (unsigned long long) answered, nbatches,
+			(double) answered / max(nbatches, (size_t) 1), secs > 0.0 ? answered / secs : 0.0,
+			percentile(0.5) * 1e3, percentile(0.99) * 1e3);
+}
+
+double inferserver::percentile(double q) const {
+	// the answer of rank floor(q * answered), counted from 0 like in a sorted list
+	uint64_t rank = (uint64_t) (q * answered);
+	uint64_t seen = 0;
+	for (int b = 0; b < nbuckets; b++) {
+		seen += histogram[b];
+		if (seen > rank) {
+			return bucket_limit(b);
+		}
+	}
+	return bucket_limit(nbuckets - 1);
+}
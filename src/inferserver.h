@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _INFERSERVER_H
+#define    _INFERSERVER_H
+
+#include <cstdio>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "matrix.h"
+
+using namespace std;
+
+class model;
+
+// Inference for single documents with a resident model. Every input line is a document, every output line the
+// answer to it, in the same order: the ntop most likely topics as topic:probability, "|" and theta.
+// A pool of worker threads samples the documents of all streams with the fixed model, in batches of up to
+// maxbatch documents: a batch waits at most window seconds after its first document for more to arrive. A worker
+// takes no more than its share of the queue among the idle workers, so a burst is spread over the pool.
+class inferserver {
+public:
+	inferserver(model *pmodel, int nworkers, int ntop, int maxbatch, double window);
+
+	~inferserver();
+
+	inferserver(const inferserver &) = delete;
+
+	inferserver &operator=(const inferserver &) = delete;
+
+	// answer the lines of in on outfd until the end of in
+	int serve_stream(FILE *in, int outfd);
+
+	// accept connections on the Unix domain socket path until SIGINT or SIGTERM, each is a stream of its own
+	int serve_socket(const string &path);
+
+	// print the number of answered documents and batches, the throughput and the p50 and p99 latency to stderr
+	void report();
+
+private:
+	struct stream;
+
+	struct request {
+		string doc;
+		string answer;
+		bool done;
+		stream *owner;
+		chrono::steady_clock::time_point arrival;
+	};
+
+	// the requests of one input in arrival order, answered from the front
+	struct stream {
+		mutex lock;
+		condition_variable changed;
+		deque<shared_ptr<request> > pending;
+		bool closed;
+	};
+
+	// a document of a batch being sampled, its words sorted
+	struct job {
+		vector<int> words;
+		vector<int> topics;
+		vector<ndcount> nd;
+		rng gen;
+	};
+
+	// a token of a batch: position pos of job
+	struct token {
+		int word;
+		int job;
+		int pos;
+	};
+
+	model *pmodel;
+	int ntop;
+	size_t maxbatch;
+	chrono::steady_clock::duration window;
+	size_t nworkers;
+
+	vector<thread> workers;
+	mutex lock;
+	condition_variable ready;
+	deque<shared_ptr<request> > queue;
+	size_t busy; // workers sampling a batch
+	bool stopping;
+
+	mutex statslock;
+	// latency from arrival to answer, as counts of logarithmic buckets, see latency_bucket
+	vector<uint64_t> histogram;
+	uint64_t answered;
+	size_t nbatches;
+	chrono::steady_clock::time_point first; // arrival of the first answered document
+	chrono::steady_clock::time_point last; // the last answer
+
+	void work();
+
+	// read the words of req.doc into jb and draw their initial topics, returns false with req.answer set if
+	// the document cannot be sampled
+	bool prepare(request &req, job &jb);
+
+	// theta and the top topics of jb into req.answer, pp is scratch space
+	void finish(request &req, const job &jb, vector<double> &pp);
+
+	void record(chrono::steady_clock::time_point arrival);
+
+	// with statslock held
+	void print_latency();
+
+	// with statslock held, the latency in seconds below which the fraction q of the answers lie, to the
+	// resolution of the buckets
+	double percentile(double q) const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cstddef>
+#include "constants.h"
+#include "kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+
+// load 4 or 8 document-topic counts as 32-bit integers
+#ifdef GIBBSLDA_ND16
+#define LOAD_ND4(ptr) _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (ptr)))
+#define LOAD_ND8(ptr) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (ptr)))
+#else
+#define LOAD_ND4(ptr) _mm_loadu_si128((const __m128i *) (ptr))
+#define LOAD_ND8(ptr) _mm256_loadu_si256((const __m256i *) (ptr))
+#endif
+#endif
+
+using namespace std;
+
+static int sample_scalar(const int *nww, const int *nww2, const ndcount *ndm, const double *invsum, int K,
+						 double alpha, double beta, double u, double *p) {
+	// compute and cumulate in one pass, the sum ends up in p[K - 1]
+	double sum = 0.0;
+	if (nww2) {
+		for (int k = 0; k < K; k++) {
+			sum += (nww[k] + nww2[k] + beta) * (ndm[k] + alpha) * invsum[k];
+			p[k] = sum;
+		}
+	} else {
+		for (int k = 0; k < K; k++) {
+			sum += (nww[k] + beta) * (ndm[k] + alpha) * invsum[k];
+			p[k] = sum;
+		}
+	}
+
+	u *= sum;
+	int topic;
+	for (topic = 0; topic < K - 1; topic++) {
+		if (p[topic] > u) {
+			break;
+		}
+	}
+	return topic;
+}
+
+#ifdef KERNEL_X86
+
+__attribute__((target("avx2,fma")))
+static int sample_avx2(const int *nww, const int *nww2, const ndcount *ndm, const double *invsum, int K,
+					   double alpha, double beta, double u, double *p) {
+	const __m256d valpha = _mm256_set1_pd(alpha);
+	const __m256d vbeta = _mm256_set1_pd(beta);
+	const __m256d zero = _mm256_setzero_pd();
+	__m256d carry = zero;
+
+	int k = 0;
+	for (; k + 4 <= K; k += 4) {
+		__m128i wi = _mm_loadu_si128((const __m128i *) (nww + k));
+		if (nww2) {
+			wi = _mm_add_epi32(wi, _mm_loadu_si128((const __m128i *) (nww2 + k)));
+		}
+		__m128i di = LOAD_ND4(ndm + k);
+		__m256d x = _mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(wi), vbeta), _mm256_loadu_pd(invsum + k));
+		x = _mm256_mul_pd(x, _mm256_add_pd(_mm256_cvtepi32_pd(di), valpha));
+
+		// inclusive prefix sum of the 4 lanes: add the vector shifted up by one lane, then by two lanes
+		x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+		x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+		x = _mm256_add_pd(x, carry);
+		_mm256_storeu_pd(p + k, x);
+		carry = _mm256_permute4x64_pd(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	double sum = _mm256_cvtsd_f64(carry);
+	for (; k < K; k++) {
+		int w = nww2 ? nww[k] + nww2[k] : nww[k];
+		sum += (w + beta) * (ndm[k] + alpha) * invsum[k];
+		p[k] = sum;
+	}
+
+	// first topic whose cumulated mass exceeds u, 4 comparisons at a time
+	u *= sum;
+	const __m256d vu = _mm256_set1_pd(u);
+	for (k = 0; k + 4 <= K; k += 4) {
+		int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p + k), vu, _CMP_GT_OQ));
+		if (mask) {
+			return k + __builtin_ctz(mask);
+		}
+	}
+	for (; k < K - 1; k++) {
+		if (p[k] > u) {
+			break;
+		}
+	}
+	return k < K ? k : K - 1;
+}
+
+__attribute__((target("avx512f")))
+static int sample_avx512(const int *nww, const int *nww2, const ndcount *ndm, const double *invsum, int K,
+						 double alpha, double beta, double u, double *p) {
+	const __m512d valpha = _mm512_set1_pd(alpha);
+	const __m512d vbeta = _mm512_set1_pd(beta);
+	// lane permutations for shifting the vector up by 1, 2 and 4 lanes, the vacated lanes are masked to zero
+	const __m512i shift1 = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0);
+	const __m512i shift2 = _mm512_set_epi64(5, 4, 3, 2, 1, 0, 0, 0);
+	const __m512i shift4 = _mm512_set_epi64(3, 2, 1, 0, 0, 0, 0, 0);
+	const __m512i last = _mm512_set1_epi64(7);
+	__m512d carry = _mm512_setzero_pd();
+
+	int k = 0;
+	for (; k + 8 <= K; k += 8) {
+		__m256i wi = _mm256_loadu_si256((const __m256i *) (nww + k));
+		if (nww2) {
+			wi = _mm256_add_epi32(wi, _mm256_loadu_si256((const __m256i *) (nww2 + k)));
+		}
+		__m256i di = LOAD_ND8(ndm + k);
+		__m512d x = _mm512_mul_pd(_mm512_add_pd(_mm512_cvtepi32_pd(wi), vbeta), _mm512_loadu_pd(invsum + k));
+		x = _mm512_mul_pd(x, _mm512_add_pd(_mm512_cvtepi32_pd(di), valpha));
+
+		x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xFE, shift1, x));
+		x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xFC, shift2, x));
+		x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xF0, shift4, x));
+		x = _mm512_add_pd(x, carry);
+		_mm512_storeu_pd(p + k, x);
+		carry = _mm512_permutexvar_pd(last, x);
+	}
+	double sum = _mm512_cvtsd_f64(carry);
+	for (; k < K; k++) {
+		int w = nww2 ? nww[k] + nww2[k] : nww[k];
+		sum += (w + beta) * (ndm[k] + alpha) * invsum[k];
+		p[k] = sum;
+	}
+
+	u *= sum;
+	const __m512d vu = _mm512_set1_pd(u);
+	for (k = 0; k + 8 <= K; k += 8) {
+		__mmask8 mask = _mm512_cmp_pd_mask(_mm512_loadu_pd(p + k), vu, _CMP_GT_OQ);
+		if (mask) {
+			return k + __builtin_ctz(mask);
+		}
+	}
+	for (; k < K - 1; k++) {
+		if (p[k] > u) {
+			break;
+		}
+	}
+	return k < K ? k : K - 1;
+}
+
+#endif
+
+dense_kernel kernel::select(int type) {
+#ifdef KERNEL_X86
+	__builtin_cpu_init();
+	bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	bool has_avx512 = __builtin_cpu_supports("avx512f");
+
+	if (type == KERNEL_AUTO) {
+		type = has_avx512 ? KERNEL_AVX512 : (has_avx2 ? KERNEL_AVX2 : KERNEL_SCALAR);
+	}
+	if (type == KERNEL_AVX512) {
+		return has_avx512 ? sample_avx512 : nullptr;
+	}
+	if (type == KERNEL_AVX2) {
+		return has_avx2 ? sample_avx2 : nullptr;
+	}
+#else
+	if (type == KERNEL_AVX2 || type == KERNEL_AVX512) {
+		return nullptr;
+	}
+#endif
+	return sample_scalar;
+}
+
+int kernel::type_of(dense_kernel k) {
+#ifdef KERNEL_X86
+	if (k == sample_avx512) {
+		return KERNEL_AVX512;
+	}
+	if (k == sample_avx2) {
+		return KERNEL_AVX2;
+	}
+#endif
+	return KERNEL_SCALAR;
+}
+
+const char *kernel::name(int type) {
+	switch (type) {
+		case KERNEL_AVX2:
+			return "avx2";
+		case KERNEL_AVX512:
+			return "avx512";
+		case KERNEL_SCALAR:
+			return "scalar";
+		default:
+			return "auto";
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _KERNEL_H
+#define    _KERNEL_H
+
+#include "matrix.h"
+
+// Draws a topic from the dense full conditional
+//   p[k] ~ (nww[k] + nww2[k] + beta) * (ndm[k] + alpha) * invsum[k]
+// where invsum[k] = 1 / (nwsum[k] + V * beta) is maintained by the caller. nww2 is the second word-topic
+// row used by inference and may be nullptr. u is uniform in [0, 1), p is scratch space for K values and
+// holds the cumulated (unnormalized) distribution afterwards.
+typedef int (*dense_kernel)(const int *nww, const int *nww2, const ndcount *ndm, const double *invsum, int K,
+							double alpha, double beta, double u, double *p);
+
+class kernel {
+public:
+	// kernel of the given type (KERNEL_AUTO picks the widest one the CPU supports),
+	// nullptr if the CPU does not support it
+	static dense_kernel select(int type);
+
+	// KERNEL_SCALAR, KERNEL_AVX2 or KERNEL_AVX512 for a kernel returned by select()
+	static int type_of(dense_kernel k);
+
+	static const char *name(int type);
+};
+
+#endif
@@ -21,7 +21,7 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
  */
 
-#include "model.h"
+#include "gibbslda.h"
 #include <cstdio>
 
 using namespace std;
@@ -29,32 +29,27 @@ using namespace std;
 void show_help();
 
 int main(int argc, char **argv) {
-	model lda;
+	gibbslda lda;
+	lda.set_verbose(true);
 
 	if (lda.init(argc, argv)) {
 		show_help();
 		return 1;
 	}
 
-	if (lda.model_status == MODEL_STATUS_EST || lda.model_status == MODEL_STATUS_ESTC) {
-		// parameter estimation
-		lda.estimate();
-	}
-
-	if (lda.model_status == MODEL_STATUS_INF) {
-		// do inference
-		lda.inference();
-	}
-
-	return 0;
+	return lda.run();
 }
 
 void show_help() {
 	printf("GibbsLDA++ v3.0 build 20191019-1503\n");
 	printf("Command line usage:\n");
-	printf("\tlda -est -alpha <double> -beta <double> -ntopics <int> -niters <int> -savestep <int> -twords <int> -dfile <string>\n");
-	printf("\tlda -estc -dir <string> -model <string> -niters <int> -savestep <int> -twords <int>\n");
-	printf("\tlda -inf -dir <string> -model <string> -niters <int> -twords <int> -dfile <string>\n");
+	printf("\tlda -est -alpha <double> -beta <double> -ntopics <int> -niters <int> -savestep <int> -twords <int> -sampler <dense|sparse|alias|grouped> -mhsteps <int> -nthreads <int> -parallel <adlda|block> -syncstep <int> -kernel <auto|scalar|avx2|avx512> -order <doc|sorted|word> -format <text|bin|bin64|sparse> -topk <int> -asyncsave -seed <int> -dfile <string>\n");
+	printf("\tlda -estc -dir <string> -model <string> -niters <int> -savestep <int> -twords <int> -sampler <dense|sparse|alias|grouped> -mhsteps <int> -nthreads <int> -parallel <adlda|block> -syncstep <int> -kernel <auto|scalar|avx2|avx512> -order <doc|sorted|word> -format <text|bin|bin64|sparse> -topk <int> -asyncsave -seed <int>\n");
+	printf("\tlda -inf -dir <string> -model <string> -niters <int> -twords <int> -kernel <auto|scalar|avx2|avx512> -format <text|bin|bin64|sparse> -topk <int> -nthreads <int> -fixed -sampler <dense|alias> -mhsteps <int> -seed <int> -dfile <string>\n");
+	printf("\tlda -convert -dfile <string>\n");
+	printf("\tlda -export -dir <string> -model <string>\n");
+	printf("\tlda -totext -dfile <string>\n");
+	printf("\tlda -serve -dir <string> -model <string> -niters <int> -nthreads <int> -topk <int> -kernel <auto|scalar|avx2|avx512> -sampler <dense|alias> -mhsteps <int> -socket <string> -maxbatch <int> -batchwindow <double> -seed <int>\n");
 	// printf("\tlda -inf -dir <string> -model <string> -niters <int> -twords <int> -dfile <string> -withrawdata\n");
 }
 
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "constants.h"
+#include "linereader.h"
+
+using namespace std;
+
+linereader::linereader() {
+	fin = nullptr;
+	owned = false;
+	begin = end = 0;
+	eof = true;
+}
+
+linereader::~linereader() {
+	close();
+}
+
+int linereader::open(const string &filename) {
+	FILE *stream = fopen(filename.c_str(), "r");
+	if (!stream) {
+		return 1;
+	}
+
+	open(stream);
+	owned = true;
+
+	return 0;
+}
+
+void linereader::open(FILE *stream) {
+	close();
+
+	fin = stream;
+	owned = false;
+	buffer.resize(BUFF_SIZE_LONG);
+	begin = end = 0;
+	eof = false;
+}
+
+void linereader::close() {
+	if (fin && owned) {
+		fclose(fin);
+	}
+	fin = nullptr;
+	owned = false;
+	begin = end = 0;
+	eof = true;
+}
+
+bool linereader::next(string_view &line) {
+	size_t scanned = begin;
+	while (true) {
+		const char *newline = (const char *) memchr(buffer.data() + scanned, '\n', end - scanned);
+		if (newline) {
+			size_t stop = newline - buffer.data();
+			line = string_view(buffer.data() + begin, stop - begin);
+			begin = stop + 1;
+			return true;
+		}
+
+		if (eof) {
+			if (begin == end) {
+				return false;
+			}
+			// last line without '\n'
+			line = string_view(buffer.data() + begin, end - begin);
+			begin = end;
+			return true;
+		}
+
+		// move the partial line to the front and read more behind it, growing the buffer for long lines
+		size_t partial = end - begin;
+		if (begin > 0) {
+			memmove(buffer.data(), buffer.data() + begin, partial);
+			begin = 0;
+			end = partial;
+		}
+		if (end == buffer.size()) {
+			buffer.resize(buffer.size() * 2);
+		}
+		scanned = end;
+
+		// read() rather than fread() returns what a pipe has so far instead of waiting for a full buffer
+		ssize_t n = read(fileno(fin), buffer.data() + end, buffer.size() - end);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			eof = true;
+		} else {
+			end += n;
+		}
+	}
+}
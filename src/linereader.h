@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _LINEREADER_H
+#define    _LINEREADER_H
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Reads a file line by line through one large buffer. Lines of any length are returned as views into the
+// buffer, without their '\n'; the buffer grows when a line does not fit.
+class linereader {
+public:
+	linereader();
+
+	~linereader();
+
+	linereader(const linereader &) = delete;
+
+	linereader &operator=(const linereader &) = delete;
+
+	// open a file to read, returns 1 if it cannot be opened
+	int open(const string &filename);
+
+	// read from a stream that is already open and not read from yet, e.g. stdin, it is not closed by close()
+	void open(FILE *stream);
+
+	void close();
+
+	// next line, false at the end of the file. The view is valid until the next call.
+	bool next(string_view &line);
+
+private:
+	FILE *fin;
+	bool owned; // fin was opened by open(filename)
+	vector<char> buffer;
+	size_t begin, end; // unread bytes of buffer
+	bool eof;
+};
+
+#endif
@@ -21,32 +21,37 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
  */
 
-#ifndef _STRTOKENIZER_H
-#define _STRTOKENIZER_H
+#ifndef    _MAPPEDFILE_H
+#define    _MAPPEDFILE_H
 
+#include <cstddef>
 #include <string>
-#include <vector>
 
 using namespace std;
 
-class strtokenizer {
-protected:
-	vector<string> tokens;
-	int idx{};
-
+// A whole file mapped read-only into memory
+class mappedfile {
 public:
-	explicit strtokenizer(const string &str, const string &seperators = " ");
+	const char *data;
+	size_t size;
+
+	mappedfile() {
+		data = nullptr;
+		size = 0;
+	}
 
-	void parse(const string &str, const string &seperators);
+	~mappedfile() {
+		close();
+	}
 
-	int count_tokens();
+	mappedfile(const mappedfile &) = delete;
 
-	string next_token();
+	mappedfile &operator=(const mappedfile &) = delete;
 
-	void start_scan();
+	// map the file, returns 1 if it cannot be opened or is empty
+	int open(const string &filename);
 
-	string token(int i);
+	void close();
 };
 
 #endif
-
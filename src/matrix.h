@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _MATRIX_H
+#define    _MATRIX_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// alignment of the matrix buffer and of every row, in bytes (one cache line, one AVX-512 register)
+#define    MATRIX_ALIGN    64
+
+// count type of the document-topic matrices, build with -DGIBBSLDA_ND16 to halve their memory when no
+// document is longer than 65535 words
+#ifdef GIBBSLDA_ND16
+typedef uint16_t ndcount;
+#else
+typedef int ndcount;
+#endif
+
+// Dense row-major matrix in one aligned heap block. Rows are padded to a multiple of MATRIX_ALIGN bytes, so
+// m[i] is aligned for SIMD loads and m[i][j] is a single multiply-add away from the base pointer.
+template<typename T>
+class matrix {
+public:
+	T *data;
+	int rows;
+	int cols;
+	size_t stride; // distance between two rows in elements
+
+	matrix() {
+		data = nullptr;
+		rows = 0;
+		cols = 0;
+		stride = 0;
+	}
+
+	matrix(int rows, int cols) : matrix() {
+		alloc(rows, cols);
+	}
+
+	matrix(const matrix &) = delete;
+
+	matrix &operator=(const matrix &) = delete;
+
+	~matrix() {
+		free(data);
+	}
+
+	// (re)allocate as rows x cols, all elements set to zero
+	void alloc(int rows, int cols) {
+		free(data);
+		this->rows = rows;
+		this->cols = cols;
+		size_t per_line = MATRIX_ALIGN / sizeof(T);
+		stride = (cols + per_line - 1) / per_line * per_line;
+		size_t bytes = (size_t) rows * stride * sizeof(T);
+		// aligned_alloc wants a multiple of the alignment, which the row padding already gives us
+		data = bytes ? (T *) aligned_alloc(MATRIX_ALIGN, bytes) : nullptr;
+		if (data) {
+			memset(data, 0, bytes);
+		}
+	}
+
+	// make this a copy of other, reusing the buffer when the shape is the same
+	void copy(const matrix &other) {
+		if (rows != other.rows || cols != other.cols || !data) {
+			alloc(other.rows, other.cols);
+		}
+		if (data) {
+			memcpy(data, other.data, (size_t) rows * stride * sizeof(T));
+		}
+	}
+
+	void clear() {
+		if (data) {
+			memset(data, 0, (size_t) rows * stride * sizeof(T));
+		}
+	}
+
+	bool empty() const {
+		return data == nullptr;
+	}
+
+	T *operator[](int row) {
+		return data + (size_t) row * stride;
+	}
+
+	const T *operator[](int row) const {
+		return data + (size_t) row * stride;
+	}
+};
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "mappedfile.h"
+#include "textwriter.h"
+#include "matrixfile.h"
+
+using namespace std;
+
+static const char matrixfile_magic[8] = {'G', 'L', 'D', 'A', 'M', 'A', 'T', 'X'};
+
+int matrixfile::write(const string &filename, const matrix<double> &values, int rows, int cols, int dtype) {
+	matrixfile_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, matrixfile_magic, sizeof(matrixfile_magic));
+	header.version = 1;
+	header.dtype = dtype;
+	header.rowmajor = 1;
+	header.rows = rows;
+	header.cols = cols;
+	header.dataoffset = MATRIX_ALIGN;
+
+	FILE *fout = fopen(filename.c_str(), "wb");
+	if (!fout) {
+		printf("Cannot open file %s to save!\n", filename.c_str());
+		return 1;
+	}
+
+	const char zeros[MATRIX_ALIGN] = {0};
+	fwrite(&header, sizeof(header), 1, fout);
+	fwrite(zeros, 1, header.dataoffset - sizeof(header), fout);
+
+	// the rows are written without the padding they have in memory
+	vector<float> narrow(dtype == 4 ? cols : 0);
+	for (int i = 0; i < rows; i++) {
+		if (dtype == 4) {
+			for (int j = 0; j < cols; j++) {
+				narrow[j] = (float) values[i][j];
+			}
+			fwrite(narrow.data(), sizeof(float), cols, fout);
+		} else {
+			fwrite(values[i], sizeof(double), cols, fout);
+		}
+	}
+
+	int failed = ferror(fout);
+	if (fclose(fout) != 0) {
+		failed = 1;
+	}
+	if (failed) {
+		printf("Cannot write file %s!\n", filename.c_str());
+		return 1;
+	}
+
+	return 0;
+}
+
+int matrixfile::to_text(const string &binfile, const string &textfile) {
+	mappedfile bin;
+	if (bin.open(binfile)) {
+		printf("Cannot open file %s to read!\n", binfile.c_str());
+		return 1;
+	}
+
+	matrixfile_header header;
+	if (bin.size < sizeof(header)) {
+		printf("Invalid binary matrix %s!\n", binfile.c_str());
+		return 1;
+	}
+	memcpy(&header, bin.data, sizeof(header));
+	if (memcmp(header.magic, matrixfile_magic, sizeof(matrixfile_magic)) != 0 || header.version != 1 ||
+		(header.dtype != 4 && header.dtype != 8) || header.rowmajor != 1 || header.dataoffset < sizeof(header)) {
+		printf("Invalid binary matrix %s!\n", binfile.c_str());
+		return 1;
+	}
+	if (bin.size < header.dataoffset + header.rows * header.cols * header.dtype) {
+		printf("Truncated binary matrix %s!\n", binfile.c_str());
+		return 1;
+	}
+
+	const char *data = bin.data + header.dataoffset;
+	size_t cols = header.cols;
+	size_t dtype = header.dtype;
+	return textwriter::write_rows(textfile, header.rows, 9 * cols + 1, [data, cols, dtype](size_t i, textbuffer &out) {
+		const char *row = data + i * cols * dtype;
+		for (size_t j = 0; j < cols; j++) {
+			if (dtype == 4) {
+				out.put((double) ((const float *) row)[j]);
+			} else {
+				out.put(((const double *) row)[j]);
+			}
+			out.put(' ');
+		}
+		out.put('\n');
+	});
+}
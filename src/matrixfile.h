@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _MATRIXFILE_H
+#define    _MATRIXFILE_H
+
+#include <cstdint>
+#include <string>
+#include "matrix.h"
+
+using namespace std;
+
+// Header of a binary theta or phi file. The values follow at dataoffset, a multiple of 64 bytes, as rows x cols
+// float32 or float64 numbers in row-major order and in the byte order of the machine that wrote them.
+struct matrixfile_header {
+	char magic[8]; // "GLDAMATX"
+	uint32_t version;
+	uint32_t dtype; // bytes per value: 4 for float32, 8 for float64
+	uint32_t rowmajor; // always 1
+	uint32_t reserved;
+	uint64_t rows; // M for theta, K for phi
+	uint64_t cols; // K for theta, V for phi
+	uint64_t dataoffset;
+	char padding[16];
+};
+
+class matrixfile {
+public:
+	// write rows x cols values with dtype 4 or 8 bytes per value
+	static int write(const string &filename, const matrix<double> &values, int rows, int cols, int dtype);
+
+	// write binfile back in the text format of the .theta and .phi files
+	static int to_text(const string &binfile, const string &textfile);
+};
+
+#endif
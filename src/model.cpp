@@ -32,106 +32,54 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
 #include "constants.h"
-#include "strtokenizer.h"
+#include "viewtokenizer.h"
+#include "linereader.h"
+#include "mappedfile.h"
+#include "binwriter.h"
 #include "utils.h"
 #include "dataset.h"
 #include "model.h"
+#include "perfcounter.h"
+#include "textwriter.h"
+#include "matrixfile.h"
+#include "inferserver.h"
 
 using namespace std;
 
 model::~model() {
+	if (psaved) {
+		join_save();
+		// the training data is shared with the snapshot
+		psaved->ptrndata = nullptr;
+		delete psaved;
+	}
 
 	delete p;
+	delete[] invsum;
+	delete psparse;
+	delete palias;
+	delete pinfalias;
+	delete pgrouped;
+	delete padlda;
+	delete pblock;
 	delete ptrndata;
 	delete pnewdata;
 
-	if (z) {
-		for (int m = 0; m < M; m++) {
-			if (z[m]) {
-				delete z[m];
-			}
-		}
-	}
-
-	if (nw) {
-		for (int w = 0; w < V; w++) {
-			if (nw[w]) {
-				delete nw[w];
-			}
-		}
-	}
-
-	if (nd) {
-		for (int m = 0; m < M; m++) {
-			if (nd[m]) {
-				delete nd[m];
-			}
-		}
-	}
-
 	delete nwsum;
 	delete ndsum;
 
-	if (theta) {
-		for (int m = 0; m < M; m++) {
-			if (theta[m]) {
-				delete theta[m];
-			}
-		}
-	}
-
-	if (phi) {
-		for (int k = 0; k < K; k++) {
-			if (phi[k]) {
-				delete phi[k];
-			}
-		}
-	}
-
-	// only for inference
-	if (newz) {
-		for (int m = 0; m < newM; m++) {
-			if (newz[m]) {
-				delete newz[m];
-			}
-		}
-	}
-
-	if (newnw) {
-		for (int w = 0; w < newV; w++) {
-			if (newnw[w]) {
-				delete newnw[w];
-			}
-		}
-	}
-
-	if (newnd) {
-		for (int m = 0; m < newM; m++) {
-			if (newnd[m]) {
-				delete newnd[m];
-			}
-		}
-	}
-
 	delete newnwsum;
 	delete newndsum;
 
-	if (newtheta) {
-		for (int m = 0; m < newM; m++) {
-			if (newtheta[m]) {
-				delete newtheta[m];
-			}
-		}
-	}
-
-	if (newphi) {
-		for (int k = 0; k < K; k++) {
-			if (newphi[k]) {
-				delete newphi[k];
-			}
-		}
-	}
 }
 
 void model::set_default_values() {
@@ -142,6 +90,8 @@ void model::set_default_values() {
 	phi_suffix = ".phi";
 	others_suffix = ".others";
 	twords_suffix = ".twords";
+	checkpoint_suffix = ".ckpt";
+	infmodel_suffix = ".infmodel";
 
 	dir = "./";
 	dfile = "trndocs.dat";
@@ -161,25 +111,40 @@ void model::set_default_values() {
 	savestep = 200;
 	twords = 0;
 	withrawstrs = 0;
+	sampler = SAMPLER_DENSE;
+	mhsteps = 2;
+	nthreads = 1;
+	parallel = PARALLEL_ADLDA;
+	kerneltype = KERNEL_AUTO;
+	seed = (uint64_t) time(nullptr);
+	syncstep = 0;
+	order = ORDER_DOC;
+	asyncsave = 0;
+	format = FORMAT_TEXT;
+	topk = 0;
+	fixedmodel = 0;
+	serveout = -1;
+	maxbatch = 32;
+	batchwindow = 0.0;
+	verbose = 1;
 
 	p = nullptr;
-	z = nullptr;
-	nw = nullptr;
-	nd = nullptr;
+	invsum = nullptr;
+	pkernel = nullptr;
 	nwsum = nullptr;
 	ndsum = nullptr;
-	theta = nullptr;
-	phi = nullptr;
+	psparse = nullptr;
+	palias = nullptr;
+	pinfalias = nullptr;
+	pgrouped = nullptr;
+	padlda = nullptr;
+	pblock = nullptr;
+	psaved = nullptr;
 
 	newM = 0;
 	newV = 0;
-	newz = nullptr;
-	newnw = nullptr;
-	newnd = nullptr;
 	newnwsum = nullptr;
 	newndsum = nullptr;
-	newtheta = nullptr;
-	newphi = nullptr;
 }
 
 int model::parse_args(int argc, char **argv) {
@@ -192,6 +157,19 @@ int model::init(int argc, char **argv) {
 		return 1;
 	}
 
+	if (model_status == MODEL_STATUS_SERVE && socketpath.empty()) {
+		// the answers go to stdout, so everything else that is printed goes to stderr
+		fflush(stdout);
+		serveout = dup(1);
+		dup2(2, 1);
+	}
+
+	// pass the same -seed to reproduce a run
+	generator = rng(seed, 0);
+	if (verbose) {
+		printf("Random seed: %llu\n", (unsigned long long) seed);
+	}
+
 	if (model_status == MODEL_STATUS_EST) {
 		// estimating the model from scratch
 		if (init_est()) {
@@ -209,6 +187,43 @@ int model::init(int argc, char **argv) {
 		if (init_inf()) {
 			return 1;
 		}
+
+	} else if (model_status == MODEL_STATUS_CONVERT) {
+		// tokenize the training data into the word map and the binary corpus, see dataset::read_trndata
+		ptrndata = new dataset;
+		if (ptrndata->read_trndata(dir + dfile, dir + wordmapfile)) {
+			printf("Fail to read training data!\n");
+			return 1;
+		}
+		printf("%d documents, %d words, %zu word occurrences\n", ptrndata->M, ptrndata->V, ptrndata->ntokens());
+
+	} else if (model_status == MODEL_STATUS_SERVE) {
+		// answer documents with the resident model
+		if (load_inf_counts()) {
+			return 1;
+		}
+		init_kernel();
+		init_fixed();
+
+	} else if (model_status == MODEL_STATUS_TOTEXT) {
+		// write a binary theta or phi file back as text, see matrixfile
+		string textfile = dfile.size() > 4 && dfile.compare(dfile.size() - 4, 4, ".bin") == 0 ?
+						  dfile.substr(0, dfile.size() - 4) : dfile + ".txt";
+		if (matrixfile::to_text(dir + dfile, dir + textfile)) {
+			return 1;
+		}
+		printf("Wrote %s\n", (dir + textfile).c_str());
+
+	} else if (model_status == MODEL_STATUS_EXPORT) {
+		// write the inference model, i.e., nw, nwsum and the word map
+		if (load_model_checkpoint(model_name) && load_model(model_name)) {
+			printf("Fail to load word-topic assignment file of the model!\n");
+			return 1;
+		}
+		init_counts(false);
+		if (dataset::read_wordmap(dir + wordmapfile, &id2word) || save_infmodel(model_name)) {
+			return 1;
+		}
 	}
 
 	return 0;
@@ -216,149 +231,557 @@ int model::init(int argc, char **argv) {
 
 int model::load_model(const string &in_model_name) {
 	string filename = dir + in_model_name + tassign_suffix;
-	FILE *fin = fopen(filename.c_str(), "r");
-	if (!fin) {
+	linereader reader;
+	if (reader.open(filename)) {
 		printf("Cannot open file %s to load model!\n", filename.c_str());
 		return 1;
 	}
 
-	char buff[BUFF_SIZE_LONG];
-	string line;
+	string_view line, token, fields[2];
 
 	// allocate memory for z and ptrndata
-	z = new int *[M];
-	ptrndata = new dataset(M);
+	z.init(K);
+	ptrndata = new dataset;
+	ptrndata->M = M;
 	ptrndata->V = V;
+	ptrndata->offsets.reserve(M + 1);
+	ptrndata->offsets.push_back(0);
 
 	for (int i = 0; i < M; i++) {
-		char *pointer = fgets(buff, BUFF_SIZE_LONG, fin);
-		if (!pointer) {
+		if (!reader.next(line)) {
 			printf("Invalid word-topic assignment file, check the number of docs!\n");
 			return 1;
 		}
 
-		line = buff;
-		strtokenizer strtok(line, " \t\r\n");
-		int length = strtok.count_tokens();
-
-		vector<int> words;
-		vector<int> topics;
-		for (int j = 0; j < length; j++) {
-			string token = strtok.token(j);
-
-			strtokenizer tok(token, ":");
-			if (tok.count_tokens() != 2) {
+		viewtokenizer strtok(line);
+		while (strtok.next(token)) {
+			int w, topic;
+			viewtokenizer tok(token, ":");
+			if (tok.next(fields, 2) != 2 || !viewtokenizer::to_int(fields[0], w) || !viewtokenizer::to_int(fields[1], topic)) {
 				printf("Invalid word-topic assignment line!\n");
 				return 1;
 			}
 
-			char *endptr = nullptr;
-			words.push_back((int) strtol(tok.token(0).c_str(), &endptr, 10));
-			topics.push_back((int) strtol(tok.token(1).c_str(), &endptr, 10));
+			ptrndata->words.push_back(w);
+			z.push_back(topic);
 		}
 
-		// allocate and add new document to the corpus
-		auto *pdoc = new document(words);
-		ptrndata->add_doc(pdoc, i);
+		// close the document in the corpus
+		ptrndata->offsets.push_back(ptrndata->words.size());
+	}
+
+	return 0;
+}
 
-		// assign values for z
-		z[i] = new int[topics.size()];
-		for (size_t j = 0; j < topics.size(); j++) {
-			z[i][j] = topics[j];
-		}
+struct checkpoint_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t zwidth; // bytes per topic assignment
+	int32_t K;
+	int32_t M;
+	int32_t V;
+	int32_t liter;
+	double alpha;
+	double beta;
+	uint64_t ntokens;
+	uint64_t tsize; // size and modification time of the .tassign file written with it
+	int64_t tmtime;
+};
+
+static const char checkpoint_magic[8] = {'G', 'L', 'D', 'A', 'C', 'K', 'P', 'T'};
+
+int model::save_model_checkpoint(const string &in_model_name) {
+	string filename = dir + in_model_name + checkpoint_suffix;
+
+	checkpoint_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+	header.version = 2;
+	header.zwidth = z.width;
+	header.K = K;
+	header.M = M;
+	header.V = V;
+	header.liter = liter;
+	header.alpha = alpha;
+	header.beta = beta;
+	header.ntokens = ptrndata->ntokens();
+	if (utils::file_stamp(dir + in_model_name + tassign_suffix, &header.tsize, &header.tmtime)) {
+		return 1;
 	}
 
-	fclose(fin);
+	binwriter out;
+	if (out.open(filename)) {
+		return 1;
+	}
 
-	return 0;
+	out.write(&header, sizeof(header), 1);
+
+	// the counts are not written, init_counts rebuilds them in one pass over the tokens
+	vector<uint64_t> offsets(ptrndata->offsets.begin(), ptrndata->offsets.end());
+	out.write(offsets.data(), sizeof(uint64_t), offsets.size());
+	if (sortedindex.empty()) {
+		out.write(ptrndata->words.data(), sizeof(int), ptrndata->words.size());
+		out.pad(ptrndata->words.size() * sizeof(int));
+		out.write(z.data(), z.width, z.size());
+	} else {
+		// in input order like the .tassign file
+		size_t ntokens = ptrndata->ntokens();
+		vector<int> words(ntokens);
+		topicarray topics;
+		topics.init(K);
+		topics.resize(ntokens);
+		for (size_t i = 0; i < ntokens; i++) {
+			words[i] = ptrndata->words[sortedindex[i]];
+			topics.set(i, z.get(sortedindex[i]));
+		}
+		out.write(words.data(), sizeof(int), ntokens);
+		out.pad(ntokens * sizeof(int));
+		out.write(topics.data(), topics.width, ntokens);
+	}
+
+	return out.commit();
 }
 
-int model::save_model(const string &in_model_name) {
-	if (save_model_tassign(dir + in_model_name + tassign_suffix)) {
+int model::load_model_checkpoint(const string &in_model_name) {
+	string filename = dir + in_model_name + checkpoint_suffix;
+
+	uint64_t tsize;
+	int64_t tmtime;
+	if (utils::file_stamp(dir + in_model_name + tassign_suffix, &tsize, &tmtime)) {
 		return 1;
 	}
 
-	if (save_model_others(dir + in_model_name + others_suffix)) {
+	mappedfile ckpt;
+	if (ckpt.open(filename)) {
 		return 1;
 	}
 
-	if (save_model_theta(dir + in_model_name + theta_suffix)) {
+	checkpoint_header header;
+	if (ckpt.size < sizeof(header)) {
+		return 1;
+	}
+	memcpy(&header, ckpt.data, sizeof(header));
+	z.init(K);
+	if (memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0 || header.version != 2) {
+		printf("Invalid checkpoint %s, ignored!\n", filename.c_str());
+		return 1;
+	}
+	// the .others file stays the source of alpha and beta, the checkpoint has to agree with it on the rest
+	if (header.tsize != tsize || header.tmtime != tmtime || header.K != K || header.M != M || header.V != V ||
+		header.liter != liter || header.zwidth != (uint32_t) z.width) {
+		printf("Checkpoint %s is out of date!\n", filename.c_str());
 		return 1;
 	}
 
-	if (save_model_phi(dir + in_model_name + phi_suffix)) {
+	// the sections one by one, so that no size can wrap around
+	size_t rest = ckpt.size - sizeof(header);
+	if ((size_t) M + 1 > rest / sizeof(uint64_t)) {
+		printf("Truncated checkpoint %s, ignored!\n", filename.c_str());
+		return 1;
+	}
+	rest -= (M + 1) * sizeof(uint64_t);
+	if (header.ntokens > rest / (sizeof(int) + header.zwidth) ||
+		binwriter::padded(header.ntokens * sizeof(int)) + header.ntokens * header.zwidth > rest) {
+		printf("Truncated checkpoint %s, ignored!\n", filename.c_str());
+		return 1;
+	}
+	size_t ntokens = header.ntokens;
+	size_t offsetsat = sizeof(header);
+	size_t wordsat = offsetsat + (M + 1) * sizeof(uint64_t);
+	size_t zat = wordsat + binwriter::padded(ntokens * sizeof(int));
+
+	// one pass over what is used as an index later, before anything is allocated
+	const uint64_t *ckptoffsets = (const uint64_t *) (ckpt.data + offsetsat);
+	const int *ckptwords = (const int *) (ckpt.data + wordsat);
+	const char *zdata = ckpt.data + zat;
+	bool valid = ckptoffsets[0] == 0 && ckptoffsets[M] == ntokens;
+	for (int m = 0; valid && m < M; m++) {
+		valid = ckptoffsets[m] <= ckptoffsets[m + 1];
+	}
+	for (size_t i = 0; valid && i < ntokens; i++) {
+		valid = ckptwords[i] >= 0 && ckptwords[i] < V;
+	}
+	for (size_t i = 0; valid && i < ntokens; i++) {
+		int topic = header.zwidth == 1 ? ((const uint8_t *) zdata)[i] :
+					(header.zwidth == 2 ? ((const uint16_t *) zdata)[i] : ((const int *) zdata)[i]);
+		valid = topic >= 0 && topic < K;
+	}
+	if (!valid) {
+		printf("Invalid checkpoint %s, ignored!\n", filename.c_str());
 		return 1;
 	}
 
-	if (twords > 0) {
-		if (save_model_twords(dir + in_model_name + twords_suffix)) {
-			return 1;
-		}
+	ptrndata = new dataset;
+	ptrndata->M = M;
+	ptrndata->V = V;
+	ptrndata->offsets.assign(ckptoffsets, ckptoffsets + M + 1);
+	ptrndata->words.resize(ntokens);
+	memcpy(ptrndata->words.data(), ckptwords, ntokens * sizeof(int));
+
+	z.resize(ntokens);
+	memcpy(z.data(), zdata, ntokens * header.zwidth);
+
+	if (verbose) {
+		printf("Loaded the checkpoint %s\n", filename.c_str());
 	}
 
 	return 0;
 }
 
-int model::save_model_tassign(const string &filename) {
-	int i, j;
-
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
+struct infmodel_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t twidth; // bytes per topic of the sparse nw
+	int32_t K;
+	int32_t V;
+	int32_t liter;
+	int32_t reserved;
+	double alpha;
+	double beta;
+	uint64_t nnz; // number of nonzero entries of nw
+	uint64_t vocabsize; // bytes of the vocabulary, including the padding
+	uint64_t tsize; // size and modification time of the .tassign and .others files it was exported from
+	int64_t tmtime;
+	uint64_t osize;
+	int64_t omtime;
+};
+
+static const char infmodel_magic[8] = {'G', 'L', 'D', 'A', 'I', 'N', 'F', 'M'};
+
+int model::save_infmodel(const string &in_model_name) {
+	string filename = dir + in_model_name + infmodel_suffix;
+
+	if (id2word.size() != V) {
+		printf("The word map does not match the model, %d words instead of %d!\n", id2word.size(), V);
 		return 1;
 	}
 
-	// write docs with topic assignments for words
-	for (i = 0; i < ptrndata->M; i++) {
-		for (j = 0; j < ptrndata->docs[i]->length; j++) {
-			fprintf(fout, "%d:%d ", ptrndata->docs[i]->words[j], z[i][j]);
+	infmodel_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, infmodel_magic, sizeof(infmodel_magic));
+	header.version = 2;
+	header.twidth = K <= 65536 ? 2 : 4;
+	header.K = K;
+	header.V = V;
+	header.liter = liter;
+	header.alpha = alpha;
+	header.beta = beta;
+	utils::file_stamp(dir + in_model_name + tassign_suffix, &header.tsize, &header.tmtime);
+	utils::file_stamp(dir + in_model_name + others_suffix, &header.osize, &header.omtime);
+
+	// nw row by row, only the topics with nonzero counts
+	vector<uint64_t> offsets(V + 1, 0);
+	vector<int> topics, counts;
+	for (int w = 0; w < V; w++) {
+		for (int k = 0; k < K; k++) {
+			if (nw[w][k] > 0) {
+				topics.push_back(k);
+				counts.push_back(nw[w][k]);
+			}
 		}
-		fprintf(fout, "\n");
+		offsets[w + 1] = counts.size();
 	}
+	header.nnz = counts.size();
 
-	fclose(fout);
+	for (int id = 0; id < V; id++) {
+		header.vocabsize += id2word.word(id).size() + 1;
+	}
+	size_t vocabbytes = header.vocabsize;
+	header.vocabsize = binwriter::padded(vocabbytes);
+
+	binwriter out;
+	if (out.open(filename)) {
+		return 1;
+	}
+
+	out.write(&header, sizeof(header), 1);
+	for (int id = 0; id < V; id++) {
+		string_view word = id2word.word(id);
+		out.write(word.data(), 1, word.size());
+		out.write("", 1, 1);
+	}
+	out.pad(vocabbytes);
+
+	out.write(nwsum, sizeof(int), K);
+	out.pad(K * sizeof(int));
+	out.write(offsets.data(), sizeof(uint64_t), offsets.size());
+	if (header.twidth == 2) {
+		vector<uint16_t> narrow(topics.begin(), topics.end());
+		out.write(narrow.data(), sizeof(uint16_t), narrow.size());
+	} else {
+		out.write(topics.data(), sizeof(int), topics.size());
+	}
+	out.pad(topics.size() * header.twidth);
+	out.write(counts.data(), sizeof(int), counts.size());
+	if (out.commit()) {
+		return 1;
+	}
+
+	printf("Wrote the inference model %s, %llu nonzero word-topic counts\n", filename.c_str(),
+		   (unsigned long long) header.nnz);
 
 	return 0;
 }
 
-int model::save_model_theta(const string &filename) {
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
+int model::load_infmodel(const string &in_model_name) {
+	string filename = dir + in_model_name + infmodel_suffix;
+
+	mappedfile infm;
+	if (infm.open(filename)) {
+		printf("Cannot open file %s to load model!\n", filename.c_str());
+		return 1;
+	}
+	if (load_infmodel(infm.data, infm.size, filename)) {
 		return 1;
 	}
 
-	for (int i = 0; i < M; i++) {
-		for (int j = 0; j < K; j++) {
-			fprintf(fout, "%f ", theta[i][j]);
+	if (verbose) {
+		printf("Loaded the inference model %s\n", filename.c_str());
+	}
+
+	return 0;
+}
+
+int model::load_infmodel(const char *data, size_t size, const string &filename) {
+	infmodel_header header;
+	if (size < sizeof(header)) {
+		printf("Invalid inference model %s!\n", filename.c_str());
+		return 1;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, infmodel_magic, sizeof(infmodel_magic)) != 0 || header.version != 2 ||
+		(header.twidth != 2 && header.twidth != 4) || header.K <= 0 || header.V <= 0) {
+		printf("Invalid inference model %s!\n", filename.c_str());
+		return 1;
+	}
+
+	// the sections one by one, so that no size can wrap around
+	size_t rest = size - sizeof(header);
+	size_t nwsumbytes = binwriter::padded(header.K * sizeof(int));
+	if (header.vocabsize > rest || nwsumbytes > rest - header.vocabsize ||
+		(uint64_t) header.V + 1 > (rest - header.vocabsize - nwsumbytes) / sizeof(uint64_t)) {
+		printf("Truncated inference model %s!\n", filename.c_str());
+		return 1;
+	}
+	size_t nnzrest = rest - header.vocabsize - nwsumbytes - (header.V + 1) * sizeof(uint64_t);
+	if (header.nnz > nnzrest / (header.twidth + sizeof(int)) ||
+		binwriter::padded(header.nnz * header.twidth) + header.nnz * sizeof(int) > nnzrest) {
+		printf("Truncated inference model %s!\n", filename.c_str());
+		return 1;
+	}
+	size_t nnz = header.nnz;
+	size_t nwsumat = sizeof(header) + header.vocabsize;
+	size_t offsetsat = nwsumat + nwsumbytes;
+	size_t topicsat = offsetsat + (header.V + 1) * sizeof(uint64_t);
+	size_t countsat = topicsat + binwriter::padded(nnz * header.twidth);
+	const int *infnwsum = (const int *) (data + nwsumat);
+	const uint64_t *infoffsets = (const uint64_t *) (data + offsetsat);
+	const uint16_t *topics16 = (const uint16_t *) (data + topicsat);
+	const int *topics32 = (const int *) (data + topicsat);
+	const int *counts = (const int *) (data + countsat);
+
+	// the words, offsets, topics and counts are used as indices and sums later, the memory may come from the caller
+	vector<string_view> words(header.V);
+	const char *word = data + sizeof(header);
+	const char *vocabend = word + header.vocabsize;
+	bool valid = infoffsets[0] == 0 && infoffsets[header.V] == nnz;
+	for (int id = 0; valid && id < header.V; id++) {
+		const char *end = (const char *) memchr(word, 0, vocabend - word);
+		valid = end != nullptr;
+		if (valid) {
+			words[id] = string_view(word, end - word);
+			word = end + 1;
 		}
-		fprintf(fout, "\n");
+	}
+	for (int w = 0; valid && w < header.V; w++) {
+		valid = infoffsets[w] <= infoffsets[w + 1];
+	}
+	vector<int64_t> sums(header.K, 0);
+	for (size_t j = 0; valid && j < nnz; j++) {
+		int k = header.twidth == 2 ? topics16[j] : topics32[j];
+		valid = k >= 0 && k < header.K && counts[j] >= 0;
+		if (valid) {
+			sums[k] += counts[j];
+		}
+	}
+	for (int k = 0; valid && k < header.K; k++) {
+		valid = infnwsum[k] == sums[k];
+	}
+	if (!valid) {
+		printf("Invalid inference model %s!\n", filename.c_str());
+		return 1;
 	}
 
-	fclose(fout);
+	K = header.K;
+	V = header.V;
+	liter = header.liter;
+	alpha = header.alpha;
+	beta = header.beta;
+
+	id2word.clear();
+	for (int id = 0; id < V; id++) {
+		id2word.add(words[id], id);
+	}
+
+	nwsum = new int[K];
+	memcpy(nwsum, infnwsum, K * sizeof(int));
+
+	nw.alloc(V, K);
+	for (int w = 0; w < V; w++) {
+		for (size_t j = infoffsets[w]; j < infoffsets[w + 1]; j++) {
+			nw[w][header.twidth == 2 ? topics16[j] : topics32[j]] = counts[j];
+		}
+	}
 
 	return 0;
 }
 
-int model::save_model_phi(const string &filename) {
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
+bool model::infmodel_current(const string &in_model_name) {
+	string filename = dir + in_model_name + infmodel_suffix;
+	if (!utils::file_exists(filename)) {
+		return false;
+	}
+
+	uint64_t tsize, osize;
+	int64_t tmtime, omtime;
+	bool tassign = utils::file_stamp(dir + in_model_name + tassign_suffix, &tsize, &tmtime) == 0;
+	bool others = utils::file_stamp(dir + in_model_name + others_suffix, &osize, &omtime) == 0;
+	if (!tassign && !others) {
+		// all that is left of the model
+		return true;
+	}
+
+	infmodel_header header;
+	FILE *fin = fopen(filename.c_str(), "rb");
+	size_t n = fin ? fread(&header, sizeof(header), 1, fin) : 0;
+	if (fin) {
+		fclose(fin);
+	}
+	if (n != 1 || memcmp(header.magic, infmodel_magic, sizeof(infmodel_magic)) != 0 || header.version != 2) {
+		printf("Invalid inference model %s, loading the model instead!\n", filename.c_str());
+		return false;
+	}
+	// liter was read from the .others file
+	if ((tassign && (header.tsize != tsize || header.tmtime != tmtime)) ||
+		(others && (header.osize != osize || header.omtime != omtime || header.liter != liter))) {
+		printf("Inference model %s is out of date, loading the model instead!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int model::save_model(const string &in_model_name) {
+	if (save_model_tassign(dir + in_model_name + tassign_suffix)) {
+		return 1;
+	}
+
+	if (save_model_others(dir + in_model_name + others_suffix)) {
+		return 1;
+	}
+
+	if (save_model_theta(dir + in_model_name + theta_suffix)) {
+		return 1;
+	}
+
+	if (save_model_phi(dir + in_model_name + phi_suffix)) {
 		return 1;
 	}
 
-	for (int i = 0; i < K; i++) {
-		for (int j = 0; j < V; j++) {
-			fprintf(fout, "%f ", phi[i][j]);
+	if (twords > 0) {
+		if (save_model_twords(dir + in_model_name + twords_suffix)) {
+			return 1;
 		}
-		fprintf(fout, "\n");
 	}
 
-	fclose(fout);
+	if (save_model_checkpoint(in_model_name)) {
+		return 1;
+	}
 
 	return 0;
 }
 
+void model::save_model_async(const string &in_model_name) {
+	// at most one save in flight, its snapshot is the buffer for the next one
+	join_save();
+
+	if (!psaved) {
+		psaved = new model;
+		psaved->dir = dir;
+		psaved->wordmapfile = wordmapfile;
+		psaved->M = M;
+		psaved->V = V;
+		psaved->K = K;
+		psaved->alpha = alpha;
+		psaved->beta = beta;
+		psaved->twords = twords;
+		psaved->format = format;
+		psaved->topk = topk;
+		psaved->id2word = id2word;
+		// the corpus is not changed by sampling, only z is
+		psaved->ptrndata = ptrndata;
+		psaved->sortedindex = sortedindex;
+		psaved->nwsum = new int[K];
+		psaved->ndsum = new int[M];
+		psaved->theta.alloc(M, K);
+		psaved->phi.alloc(K, V);
+	}
+
+	psaved->liter = liter;
+	psaved->z = z;
+	psaved->nw.copy(nw);
+	psaved->nd.copy(nd);
+	memcpy(psaved->nwsum, nwsum, K * sizeof(int));
+	memcpy(psaved->ndsum, ndsum, M * sizeof(int));
+
+	model *pm = psaved;
+	saver = thread([pm, in_model_name]() {
+		pm->compute_theta();
+		pm->compute_phi();
+		if (pm->save_model(in_model_name)) {
+			printf("Fail to save the model %s!\n", in_model_name.c_str());
+		}
+	});
+}
+
+void model::join_save() {
+	if (saver.joinable()) {
+		saver.join();
+	}
+}
+
+int model::save_model_tassign(const string &filename) {
+	// write docs with topic assignments for words
+	size_t rowbytes = ptrndata->M > 0 ? 8 * ptrndata->ntokens() / ptrndata->M + 1 : 1;
+	return textwriter::write_rows(filename, ptrndata->M, rowbytes, [this](size_t m, textbuffer &out) {
+		for (size_t i = ptrndata->offsets[m]; i < ptrndata->offsets[m + 1]; i++) {
+			// in input order, whatever order the sampler uses
+			size_t j = sortedindex.empty() ? i : sortedindex[i];
+			out.put(ptrndata->words[j]);
+			out.put(':');
+			out.put(z.get(j));
+			out.put(' ');
+		}
+		out.put('\n');
+	});
+}
+
+int model::save_model_theta(const string &filename) {
+	vector<double> smoothing(M);
+	for (int m = 0; m < M; m++) {
+		smoothing[m] = alpha / (ndsum[m] + K * alpha);
+	}
+	return save_rows(filename, theta, M, K, smoothing);
+}
+
+int model::save_model_phi(const string &filename) {
+	vector<double> smoothing(K);
+	for (int k = 0; k < K; k++) {
+		smoothing[k] = beta / (nwsum[k] + V * beta);
+	}
+	return save_rows(filename, phi, K, V, smoothing);
+}
+
 int model::save_model_others(const string &filename) {
 	FILE *fout = fopen(filename.c_str(), "w");
 	if (!fout) {
@@ -390,10 +813,8 @@ int model::save_model_twords(const string &filename) {
 		printf("Set number of most likely words to V: %i\n", V);
 		twords = V;
 	}
-	mapid2word::iterator it;
-
 	if (id2word.empty()) {
-		printf("Something went wrong with loading the words, size of id2word: %zu\n", id2word.size());
+		printf("Something went wrong with loading the words, size of id2word: %d\n", id2word.size());
 		return -1;
 	}
 
@@ -411,9 +832,9 @@ int model::save_model_twords(const string &filename) {
 
 		fprintf(fout, "Topic %dth:\n", k);
 		for (int i = 0; i < twords; i++) {
-			it = id2word.find(words_probs[i].first);
-			if (it != id2word.end()) {
-				fprintf(fout, "\t%s   %f\n", (it->second).c_str(), words_probs[i].second);
+			if (id2word.has(words_probs[i].first)) {
+				string_view word = id2word.word(words_probs[i].first);
+				fprintf(fout, "\t%.*s   %f\n", (int) word.size(), word.data(), words_probs[i].second);
 			}
 		}
 	}
@@ -450,65 +871,84 @@ int model::save_inf_model(const string &in_model_name) {
 }
 
 int model::save_inf_model_tassign(const string &filename) {
-	int i, j;
-
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
-		return 1;
-	}
-
 	// wirte docs with topic assignments for words
-	for (i = 0; i < pnewdata->M; i++) {
-		for (j = 0; j < pnewdata->docs[i]->length; j++) {
-			fprintf(fout, "%d:%d ", pnewdata->docs[i]->words[j], newz[i][j]);
+	size_t rowbytes = pnewdata->M > 0 ? 8 * pnewdata->ntokens() / pnewdata->M + 1 : 1;
+	return textwriter::write_rows(filename, pnewdata->M, rowbytes, [this](size_t m, textbuffer &out) {
+		for (size_t i = pnewdata->offsets[m]; i < pnewdata->offsets[m + 1]; i++) {
+			out.put(pnewdata->words[i]);
+			out.put(':');
+			out.put(newz.get(i));
+			out.put(' ');
 		}
-		fprintf(fout, "\n");
-	}
-
-	fclose(fout);
-
-	return 0;
+		out.put('\n');
+	});
 }
 
 int model::save_inf_model_newtheta(const string &filename) {
-	int i, j;
-
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
-		return 1;
-	}
-
-	for (i = 0; i < newM; i++) {
-		for (j = 0; j < K; j++) {
-			fprintf(fout, "%f ", newtheta[i][j]);
-		}
-		fprintf(fout, "\n");
+	vector<double> smoothing(newM);
+	for (int m = 0; m < newM; m++) {
+		smoothing[m] = alpha / (newndsum[m] + K * alpha);
 	}
-
-	fclose(fout);
-
-	return 0;
+	return save_rows(filename, newtheta, newM, K, smoothing);
 }
 
 int model::save_inf_model_newphi(const string &filename) {
-	FILE *fout = fopen(filename.c_str(), "w");
-	if (!fout) {
-		printf("Cannot open file %s to save!\n", filename.c_str());
-		return 1;
+	vector<double> smoothing(K);
+	for (int k = 0; k < K; k++) {
+		smoothing[k] = beta / (nwsum[k] + newnwsum[k] + V * beta);
 	}
+	return save_rows(filename, newphi, K, newV, smoothing);
+}
 
-	for (int i = 0; i < K; i++) {
-		for (int j = 0; j < newV; j++) {
-			fprintf(fout, "%f ", newphi[i][j]);
-		}
-		fprintf(fout, "\n");
-	}
+int model::save_rows(const string &filename, const matrix<double> &values, int rows, int cols,
+					 const vector<double> &smoothing) {
+	if (format == FORMAT_BIN || format == FORMAT_BIN64) {
+		return matrixfile::write(filename + ".bin", values, rows, cols, format == FORMAT_BIN ? 4 : 8);
+	}
+
+	if (format == FORMAT_SPARSE) {
+		// a value is above the smoothing of its row exactly when its count is not zero
+		size_t rowbytes = 16 * (size_t) (topk > 0 ? min(topk, cols) : cols) + 16;
+		int limit = topk;
+		return textwriter::write_rows(filename + ".sparse", rows, rowbytes,
+									  [&values, &smoothing, cols, limit](size_t i, textbuffer &out) {
+			const double *row = values[i];
+			vector<pair<int, double> > entries;
+			for (int j = 0; j < cols; j++) {
+				if (row[j] > smoothing[i]) {
+					entries.emplace_back(j, row[j]);
+				}
+			}
+			if (limit > 0 && (int) entries.size() > limit) {
+				// keep the k largest values, ties broken by the lower column, in column order
+				nth_element(entries.begin(), entries.begin() + limit, entries.end(),
+							[](const pair<int, double> &a, const pair<int, double> &b) {
+					return a.second > b.second || (a.second == b.second && a.first < b.first);
+				});
+				entries.resize(limit);
+				sort(entries.begin(), entries.end());
+			}
 
-	fclose(fout);
+			out.put_shortest(smoothing[i]);
+			for (auto &entry : entries) {
+				out.put(' ');
+				out.put(entry.first);
+				out.put(':');
+				out.put(entry.second);
+			}
+			out.put('\n');
+		});
+	}
 
-	return 0;
+	// "%f " is at most 9 characters for a probability
+	return textwriter::write_rows(filename, rows, 9 * (size_t) cols + 1, [&values, cols](size_t i, textbuffer &out) {
+		const double *row = values[i];
+		for (int j = 0; j < cols; j++) {
+			out.put(row[j]);
+			out.put(' ');
+		}
+		out.put('\n');
+	});
 }
 
 int model::save_inf_model_others(const string &filename) {
@@ -540,7 +980,6 @@ int model::save_inf_model_twords(const string &filename) {
 	if (twords > newV) {
 		twords = newV;
 	}
-	mapid2word::iterator it;
 	map<int, int>::iterator _it;
 
 	for (int k = 0; k < K; k++) {
@@ -561,9 +1000,9 @@ int model::save_inf_model_twords(const string &filename) {
 			if (_it == pnewdata->_id2id.end()) {
 				continue;
 			}
-			it = id2word.find(_it->second);
-			if (it != id2word.end()) {
-				fprintf(fout, "\t%s   %f\n", (it->second).c_str(), words_probs[i].second);
+			if (id2word.has(_it->second)) {
+				string_view word = id2word.word(_it->second);
+				fprintf(fout, "\t%.*s   %f\n", (int) word.size(), word.data(), words_probs[i].second);
 			}
 		}
 	}
@@ -574,17 +1013,38 @@ int model::save_inf_model_twords(const string &filename) {
 }
 
 
-int model::init_est() {
-	int m, n, w, k;
+int model::check_ndcount(dataset *pdata) {
+	for (int m = 0; m < pdata->M; m++) {
+		if (pdata->length(m) > numeric_limits<ndcount>::max()) {
+			printf("Document %d has %d words, too many for %zu-bit document-topic counts!\n",
+				   m, pdata->length(m), sizeof(ndcount) * 8);
+			return 1;
+		}
+	}
 
-	p = new double[K];
+	return 0;
+}
 
+int model::init_est() {
 	// + read training data
 	ptrndata = new dataset;
 	if (ptrndata->read_trndata(dir + dfile, dir + wordmapfile)) {
 		printf("Fail to read training data!\n");
 		return 1;
 	}
+	if (check_ndcount(ptrndata)) {
+		return 1;
+	}
+
+	init_est_corpus();
+
+	return 0;
+}
+
+void model::init_est_corpus() {
+	int m, k;
+
+	p = new double[K];
 
 	// + allocate memory and assign values for variables
 	M = ptrndata->M;
@@ -593,21 +1053,8 @@ int model::init_est() {
 	// alpha, beta: from command line or default values
 	// niters, savestep: from command line or default values
 
-	nw = new int *[V];
-	for (w = 0; w < V; w++) {
-		nw[w] = new int[K];
-		for (k = 0; k < K; k++) {
-			nw[w][k] = 0;
-		}
-	}
-
-	nd = new int *[M];
-	for (m = 0; m < M; m++) {
-		nd[m] = new int[K];
-		for (k = 0; k < K; k++) {
-			nd[m][k] = 0;
-		}
-	}
+	nw.alloc(V, K);
+	nd.alloc(M, K);
 
 	nwsum = new int[K];
 	for (k = 0; k < K; k++) {
@@ -619,19 +1066,18 @@ int model::init_est() {
 		ndsum[m] = 0;
 	}
 
-	srandom(time(nullptr)); // initialize for random number generation
-	z = new int *[M];
+	z.init(K);
+	z.resize(ptrndata->ntokens());
 	for (m = 0; m < ptrndata->M; m++) {
-		int N = ptrndata->docs[m]->length;
-		z[m] = new int[N];
+		int N = ptrndata->length(m);
 
 		// initialize for z
-		for (n = 0; n < N; n++) {
-			int topic = (int) (((double) random() / RAND_MAX) * K);
-			z[m][n] = topic;
+		for (size_t i = ptrndata->offsets[m]; i < ptrndata->offsets[m + 1]; i++) {
+			int topic = generator.below(K);
+			z.set(i, topic);
 
 			// number of instances of word i assigned to topic j
-			nw[ptrndata->docs[m]->words[n]][topic] += 1;
+			nw[ptrndata->words[i]][topic] += 1;
 			// number of words in document i assigned to topic j
 			nd[m][topic] += 1;
 			// total number of words assigned to topic j
@@ -641,64 +1087,40 @@ int model::init_est() {
 		ndsum[m] = N;
 	}
 
-	theta = new double *[M];
-	for (m = 0; m < M; m++) {
-		theta[m] = new double[K];
-	}
-
-	phi = new double *[K];
-	for (k = 0; k < K; k++) {
-		phi[k] = new double[V];
-	}
+	theta.alloc(M, K);
+	phi.alloc(K, V);
 
-	return 0;
+	init_sampler();
 }
 
-int model::init_estc() {
-	// estimating the model from a previously estimated one
-	int m, n, w, k;
-
-	p = new double[K];
-
-	// load model, i.e., read z and ptrndata
-	if (load_model(model_name)) {
-		printf("Fail to load word-topic assignment file of the model!\n");
-		return 1;
-	}
-
-	nw = new int *[V];
-	for (w = 0; w < V; w++) {
-		nw[w] = new int[K];
-		for (k = 0; k < K; k++) {
-			nw[w][k] = 0;
-		}
+void model::init_counts(bool docs) {
+	nw.alloc(V, K);
+	nwsum = new int[K];
+	for (int k = 0; k < K; k++) {
+		nwsum[k] = 0;
 	}
 
-	nd = new int *[M];
-	for (m = 0; m < M; m++) {
-		nd[m] = new int[K];
-		for (k = 0; k < K; k++) {
-			nd[m][k] = 0;
+	if (!docs) {
+		for (size_t i = 0; i < ptrndata->ntokens(); i++) {
+			nw[ptrndata->words[i]][z.get(i)] += 1;
+			nwsum[z.get(i)] += 1;
 		}
+		return;
 	}
 
-	nwsum = new int[K];
-	for (k = 0; k < K; k++) {
-		nwsum[k] = 0;
-	}
-
+	nd.alloc(M, K);
 	ndsum = new int[M];
-	for (m = 0; m < M; m++) {
+	for (int m = 0; m < M; m++) {
 		ndsum[m] = 0;
 	}
 
-	for (m = 0; m < ptrndata->M; m++) {
-		int N = ptrndata->docs[m]->length;
+	for (int m = 0; m < ptrndata->M; m++) {
+		int N = ptrndata->length(m);
 
 		// assign values for nw, nd, nwsum, and ndsum
-		for (n = 0; n < N; n++) {
-			int ww = ptrndata->docs[m]->words[n];
-			int topic = z[m][n];
+		for (size_t i = ptrndata->offsets[m]; i < ptrndata->offsets[m + 1]; i++) {
+			int ww = ptrndata->words[i];
+			int topic = z.get(i);
 
 			// number of instances of word i assigned to topic j
 			nw[ww][topic] += 1;
@@ -710,66 +1132,248 @@ int model::init_estc() {
 		// total number of words in document i
 		ndsum[m] = N;
 	}
+}
 
-	theta = new double *[M];
-	for (m = 0; m < M; m++) {
-		theta[m] = new double[K];
-	}
+int model::init_estc() {
+	// estimating the model from a previously estimated one
+	p = new double[K];
 
-	phi = new double *[K];
-	for (k = 0; k < K; k++) {
-		phi[k] = new double[V];
+	// load model, i.e., read z and ptrndata, from the binary checkpoint if it is up to date
+	if (load_model_checkpoint(model_name) && load_model(model_name)) {
+		printf("Fail to load word-topic assignment file of the model!\n");
+		return 1;
 	}
+	init_counts(true);
+	if (check_ndcount(ptrndata)) {
+		return 1;
+	}
+
+	theta.alloc(M, K);
+	phi.alloc(K, V);
+
+	init_sampler();
 
 	return 0;
 }
 
+void model::init_sampler() {
+	if (nthreads > 1 && sampler != SAMPLER_DENSE) {
+		printf("Multi-threaded estimation uses the dense sampler!\n");
+		sampler = SAMPLER_DENSE;
+	}
+
+	init_order();
+
+	if (nthreads > 1) {
+		if (parallel == PARALLEL_BLOCK) {
+			pblock = new blocklda(this, nthreads);
+		} else {
+			padlda = new adlda(this, nthreads, syncstep);
+		}
+	} else if (sampler == SAMPLER_SPARSE) {
+		psparse = new sparselda(this);
+	} else if (sampler == SAMPLER_ALIAS) {
+		palias = new aliaslda(this);
+	} else if (sampler == SAMPLER_GROUPED) {
+		// single words are sampled with the dense kernel
+		init_kernel();
+		pgrouped = new groupedlda(this);
+	} else {
+		init_kernel();
+	}
+}
+
+void model::select_kernel() {
+	pkernel = kernel::select(kerneltype);
+	if (!pkernel) {
+		printf("The CPU does not support the %s kernel, using the scalar one!\n", kernel::name(kerneltype));
+		pkernel = kernel::select(KERNEL_SCALAR);
+	}
+	if (verbose) {
+		printf("Sampling kernel: %s\n", kernel::name(kernel::type_of(pkernel)));
+	}
+}
+
+void model::init_order() {
+	if (order == ORDER_WORD && (nthreads > 1 || sampler == SAMPLER_SPARSE || sampler == SAMPLER_GROUPED)) {
+		printf("Word-major order needs the dense or alias sampler with one thread, sorting the documents instead!\n");
+		order = ORDER_SORTED;
+	}
+	if (sampler == SAMPLER_GROUPED) {
+		// the occurrences of a word in a document have to be consecutive
+		order = ORDER_SORTED;
+	}
+
+	if (order == ORDER_SORTED) {
+		// sort the words of every document by word id, z moves along, the counts do not change; sortedindex
+		// remembers where every token went, so that the model is still saved in input order
+		vector<tuple<int, int, size_t> > tokens;
+		sortedindex.resize(ptrndata->ntokens());
+		for (int m = 0; m < M; m++) {
+			size_t begin = ptrndata->offsets[m];
+			tokens.clear();
+			for (size_t i = begin; i < ptrndata->offsets[m + 1]; i++) {
+				tokens.emplace_back(ptrndata->words[i], z.get(i), i);
+			}
+			sort(tokens.begin(), tokens.end());
+			for (size_t j = 0; j < tokens.size(); j++) {
+				ptrndata->words[begin + j] = get<0>(tokens[j]);
+				z.set(begin + j, get<1>(tokens[j]));
+				sortedindex[get<2>(tokens[j])] = begin + j;
+			}
+		}
+	} else if (order == ORDER_WORD) {
+		// inverted index by counting sort, the occurrences of a word stay in document order
+		size_t ntokens = ptrndata->ntokens();
+		wordoffsets.assign(V + 1, 0);
+		for (size_t i = 0; i < ntokens; i++) {
+			wordoffsets[ptrndata->words[i] + 1]++;
+		}
+		for (int w = 0; w < V; w++) {
+			wordoffsets[w + 1] += wordoffsets[w];
+		}
+
+		wordtokens.resize(ntokens);
+		worddocs.resize(ntokens);
+		vector<size_t> next(wordoffsets.begin(), wordoffsets.end() - 1);
+		for (int m = 0; m < M; m++) {
+			for (size_t i = ptrndata->offsets[m]; i < ptrndata->offsets[m + 1]; i++) {
+				size_t j = next[ptrndata->words[i]]++;
+				wordtokens[j] = i;
+				worddocs[j] = m;
+			}
+		}
+	}
+}
+
+void model::init_kernel() {
+	select_kernel();
+
+	invsum = new double[K];
+	for (int k = 0; k < K; k++) {
+		invsum[k] = 1.0 / (nwsum[k] + (newnwsum ? newnwsum[k] : 0) + V * beta);
+	}
+}
+
 void model::estimate() {
 	if (twords > 0) {
 		// print out top words per topic
 		dataset::read_wordmap(dir + wordmapfile, &id2word);
 	}
 
-	printf("Sampling %d iterations!\n", niters);
+	sample_iterations();
+
+	printf("Saving the final model!\n");
+	compute_theta();
+	compute_phi();
+	save_model(utils::generate_model_name(-1));
+}
+
+void model::sample_iterations() {
+	if (verbose) {
+		printf("Sampling %d iterations!\n", niters);
+	}
+
+	size_t ntokens = ptrndata->ntokens();
+	double total_secs = 0.0;
+	perfcounter misses;
+	long long total_misses = 0;
 
 	int last_iter = liter;
 	for (liter = last_iter + 1; liter <= niters + last_iter; liter++) {
-		printf("Iteration %d ...\n", liter);
+		if (verbose) {
+			printf("Iteration %d ...", liter);
+			fflush(stdout);
+		}
+		auto start = chrono::steady_clock::now();
+		misses.start();
+
+		if (padlda) {
+			padlda->iteration();
+		} else if (pblock) {
+			pblock->iteration();
+		} else if (sampler == SAMPLER_SPARSE) {
+			psparse->begin_iteration();
+			for (int m = 0; m < M; m++) {
+				psparse->sample_doc(m);
+			}
+		} else if (sampler == SAMPLER_GROUPED) {
+			for (int m = 0; m < M; m++) {
+				pgrouped->sample_doc(m);
+			}
+		} else if (sampler == SAMPLER_ALIAS && order == ORDER_WORD) {
+			for (int w = 0; w < V; w++) {
+				palias->sample_word(w);
+			}
+		} else if (sampler == SAMPLER_ALIAS) {
+			for (int m = 0; m < M; m++) {
+				palias->sample_doc(m);
+			}
+		} else if (order == ORDER_WORD) {
+			// for all z_i, word by word
+			for (int w = 0; w < V; w++) {
+				for (size_t j = wordoffsets[w]; j < wordoffsets[w + 1]; j++) {
+					size_t i = wordtokens[j];
+					z.set(i, sampling(worddocs[j], i));
+				}
+			}
+		} else {
+			// for all z_i
+			for (int m = 0; m < M; m++) {
+				for (size_t i = ptrndata->offsets[m]; i < ptrndata->offsets[m + 1]; i++) {
+					// (z_i = z[i])
+					// sample from p(z_i|z_-i, w)
+					int topic = sampling(m, i);
+					z.set(i, topic);
+				}
+			}
+		}
 
-		// for all z_i
-		for (int m = 0; m < M; m++) {
-			for (int n = 0; n < ptrndata->docs[m]->length; n++) {
-				// (z_i = z[m][n])
-				// sample from p(z_i|z_-i, w)
-				int topic = sampling(m, n);
-				z[m][n] = topic;
+		long long iter_misses = misses.stop();
+		double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		total_secs += secs;
+		total_misses += iter_misses;
+		if (verbose) {
+			printf(" %.0f tokens/sec", ntokens / secs);
+			if (misses.available()) {
+				printf(", %.3f cache misses/token", (double) iter_misses / ntokens);
 			}
+			printf("\n");
 		}
 
 		if (savestep > 0) {
 			if (liter % savestep == 0) {
 				// saving the model
 				printf("Saving the model at iteration %d ...\n", liter);
-				compute_theta();
-				compute_phi();
-				save_model(utils::generate_model_name(liter));
+				if (asyncsave) {
+					save_model_async(utils::generate_model_name(liter));
+				} else {
+					compute_theta();
+					compute_phi();
+					save_model(utils::generate_model_name(liter));
+				}
 			}
 		}
 	}
 
-	printf("Gibbs sampling completed!\n");
-	printf("Saving the final model!\n");
-	compute_theta();
-	compute_phi();
+	if (verbose) {
+		printf("Gibbs sampling completed!\n");
+		if (total_secs > 0.0) {
+			printf("Average sampling speed: %.0f tokens/sec\n", ntokens * (double) niters / total_secs);
+		}
+		if (misses.available() && niters > 0) {
+			printf("Average cache misses: %.3f per token\n", (double) total_misses / ((double) ntokens * niters));
+		}
+	}
+	join_save();
 	liter--;
-	save_model(utils::generate_model_name(-1));
 }
 
 /**
  * This demonstrates the nature of Gibbs sampling, namely some pop and push action on a stack (of counting variables).
  * 
- * @class_param z[][]
- *   id of topic for document index "m" and word index "n", called the "topic assignment" variable 
+ * @class_param z[]
+ *   id of topic for the word at corpus index "i", called the "topic assignment" variable 
  * @class_param nw[][]
  *   frequency of word "w" in topic "topic"
  * @class_param nd[][]
@@ -790,44 +1394,29 @@ void model::estimate() {
  *
  * @param m
  *   document, index of the document to sample
- * @param n
- *   word, index of the word to sample (does not need to occur in the document)
+ * @param i
+ *   word, index of the word to sample in the corpus, between offsets[m] and offsets[m + 1]
  */
-int model::sampling(int m, int n) {
+int model::sampling(int m, size_t i) {
 	// remove z_i from the count variables
-	int topic = z[m][n];
-	int w = ptrndata->docs[m]->words[n];
+	int topic = z.get(i);
+	int w = ptrndata->words[i];
 	nw[w][topic] -= 1;
 	nd[m][topic] -= 1;
 	nwsum[topic] -= 1;
 	ndsum[m] -= 1;
+	invsum[topic] = 1.0 / (nwsum[topic] + V * beta);
 
-	double Vbeta = V * beta;
-	double Kalpha = K * alpha;
-	// do multinomial sampling via cumulative method
-	for (int k = 0; k < K; k++) {
-		p[k] = (nw[w][k] + beta) / (nwsum[k] + Vbeta) *
-			   (nd[m][k] + alpha) / (ndsum[m] + Kalpha);
-	}
-	// cumulate multinomial parameters, sum will be in p[K-1]
-	for (int k = 1; k < K; k++) {
-		p[k] += p[k - 1];
-	}
-	// scaled sample because of unnormalized p[]
-	double u = ((double) random() / RAND_MAX) * p[K - 1];
-
-	// get topic with probability beyond u
-	for (topic = 0; topic < K; topic++) {
-		if (p[topic] > u) {
-			break;
-		}
-	}
+	// do multinomial sampling via cumulative method, 1 / (ndsum[m] + K * alpha) is the same for all topics
+	// and is left out, the kernel scales the sample by the sum of the unnormalized p[]
+	topic = pkernel(nw[w], nullptr, nd[m], invsum, K, alpha, beta, generator.uniform(), p);
 
 	// add newly estimated z_i to count variables
 	nw[w][topic] += 1;
 	nd[m][topic] += 1;
 	nwsum[topic] += 1;
 	ndsum[m] += 1;
+	invsum[topic] = 1.0 / (nwsum[topic] + V * beta);
 
 	return topic;
 }
@@ -848,95 +1437,73 @@ void model::compute_phi() {
 	}
 }
 
-int model::init_inf() {
-	// estimating the model from a previously estimated one
-	//int m, n, w, k;
-
-	p = new double[K];
-
-	// load moel, i.e., read z and ptrndata
-	if (load_model(model_name)) {
-		printf("Fail to load word-topic assignmetn file of the model!\n");
-		return 1;
-	}
-
-	nw = new int *[V];
-	for (int w = 0; w < V; w++) {
-		nw[w] = new int[K];
-		for (int k = 0; k < K; k++) {
-			nw[w][k] = 0;
+int model::load_inf_counts() {
+	// load the model: the inference export if it is up to date, otherwise nw and nwsum counted from the checkpoint
+	// or the .tassign file, the training documents themselves are not kept
+	if (infmodel_current(model_name)) {
+		if (load_infmodel(model_name)) {
+			printf("Fail to load the inference model!\n");
+			return 1;
 		}
-	}
-
-	nd = new int *[M];
-	for (int m = 0; m < M; m++) {
-		nd[m] = new int[K];
-		for (int k = 0; k < K; k++) {
-			nd[m][k] = 0;
+	} else {
+		if (load_model_checkpoint(model_name) && load_model(model_name)) {
+			printf("Fail to load word-topic assignment file of the model!\n");
+			return 1;
+		}
+		init_counts(false);
+		delete ptrndata;
+		ptrndata = nullptr;
+		z = topicarray();
+		if (dataset::read_wordmap(dir + wordmapfile, &id2word)) {
+			return 1;
 		}
 	}
 
-	nwsum = new int[K];
-	for (int k = 0; k < K; k++) {
-		nwsum[k] = 0;
-	}
+	return 0;
+}
 
-	ndsum = new int[M];
-	for (int m = 0; m < M; m++) {
-		ndsum[m] = 0;
+int model::read_inf_others() {
+	string filename = dir + model_name + others_suffix;
+	if (!utils::file_exists(filename) && utils::file_exists(dir + model_name + infmodel_suffix)) {
+		// the inference export holds ntopics, alpha and beta itself
+		return 0;
 	}
+	return utils::read_and_parse(filename, this);
+}
 
-	for (int m = 0; m < ptrndata->M; m++) {
-		int N = ptrndata->docs[m]->length;
-
-		// assign values for nw, nd, nwsum, and ndsum
-		for (int n = 0; n < N; n++) {
-			int ww = ptrndata->docs[m]->words[n];
-			int topic = z[m][n];
+int model::init_inf() {
+	// estimating the model from a previously estimated one
+	//int m, n, w, k;
 
-			// number of instances of word i assigned to topic j
-			nw[ww][topic] += 1;
-			// number of words in document i assigned to topic j
-			nd[m][topic] += 1;
-			// total number of words assigned to topic j
-			nwsum[topic] += 1;
-		}
-		// total number of words in document i
-		ndsum[m] = N;
+	if (load_inf_counts()) {
+		return 1;
 	}
 
+	p = new double[K];
+
 	// read new data for inference
 	pnewdata = new dataset;
 	if (withrawstrs) {
-		if (pnewdata->read_newdata_withrawstrs(dir + dfile, dir + wordmapfile)) {
+		if (pnewdata->read_newdata_withrawstrs(dir + dfile, &id2word)) {
 			printf("Fail to read new data!\n");
 			return 1;
 		}
 	} else {
-		if (pnewdata->read_newdata(dir + dfile, dir + wordmapfile)) {
+		if (pnewdata->read_newdata(dir + dfile, &id2word)) {
 			printf("Fail to read new data!\n");
 			return 1;
 		}
 	}
 
+	if (check_ndcount(pnewdata)) {
+		return 1;
+	}
+
 	newM = pnewdata->M;
 	newV = pnewdata->V;
 
-	newnw = new int *[newV];
-	for (int w = 0; w < newV; w++) {
-		newnw[w] = new int[K];
-		for (int k = 0; k < K; k++) {
-			newnw[w][k] = 0;
-		}
-	}
-
-	newnd = new int *[newM];
-	for (int m = 0; m < newM; m++) {
-		newnd[m] = new int[K];
-		for (int k = 0; k < K; k++) {
-			newnd[m][k] = 0;
-		}
-	}
+	newnw.alloc(newV, K);
+	newnd.alloc(newM, K);
 
 	newnwsum = new int[K];
 	for (int k = 0; k < K; k++) {
@@ -948,18 +1515,16 @@ int model::init_inf() {
 		newndsum[m] = 0;
 	}
 
-	srandom(time(nullptr)); // initialize for random number generation
-	newz = new int *[newM];
+	newz.init(K);
+	newz.resize(pnewdata->ntokens());
 	for (int m = 0; m < pnewdata->M; m++) {
-		int N = pnewdata->docs[m]->length;
-		newz[m] = new int[N];
+		int N = pnewdata->length(m);
 
 		// assign values for nw, nd, nwsum, and ndsum
-		for (int n = 0; n < N; n++) {
-			int w = pnewdata->docs[m]->words[n];
-			int _w = pnewdata->_docs[m]->words[n];
-			int topic = (int) (((double) random() / RAND_MAX) * K);
-			newz[m][n] = topic;
+		for (size_t i = pnewdata->offsets[m]; i < pnewdata->offsets[m + 1]; i++) {
+			int _w = pnewdata->_words[i];
+			int topic = generator.below(K);
+			newz.set(i, topic);
 
 			// number of instances of word i assigned to topic j
 			newnw[_w][topic] += 1;
@@ -972,23 +1537,40 @@ int model::init_inf() {
 		newndsum[m] = N;
 	}
 
-	newtheta = new double *[newM];
-	for (int m = 0; m < newM; m++) {
-		newtheta[m] = new double[K];
-	}
+	newtheta.alloc(newM, K);
+	newphi.alloc(K, newV);
 
-	newphi = new double *[K];
-	for (int k = 0; k < K; k++) {
-		newphi[k] = new double[newV];
-	}
+	init_kernel();
 
 	return 0;
 }
 
+int model::serve() {
+	fflush(stdout);
+	inferserver server(this, max(nthreads, 1), topk > 0 ? topk : 5, maxbatch, batchwindow / 1000.0);
+	int failed;
+	if (socketpath.empty()) {
+		failed = server.serve_stream(stdin, serveout);
+	} else {
+		failed = server.serve_socket(socketpath);
+	}
+	server.report();
+
+	return failed;
+}
+
 void model::inference() {
-	if (twords > 0) {
-		// print out top words per topic
-		dataset::read_wordmap(dir + wordmapfile, &id2word);
+	if (nthreads > 1 && !fixedmodel) {
+		printf("Multi-threaded inference uses the fixed model!\n");
+		fixedmodel = 1;
+	}
+	if (sampler == SAMPLER_ALIAS && !fixedmodel) {
+		printf("Alias inference uses the fixed model!\n");
+		fixedmodel = 1;
+	}
+	if (fixedmodel) {
+		inference_fixed();
+		return;
 	}
 
 	printf("Sampling %d iterations for inference!\n", niters);
@@ -998,11 +1580,11 @@ void model::inference() {
 
 		// for all newz_i
 		for (int m = 0; m < newM; m++) {
-			for (int n = 0; n < pnewdata->docs[m]->length; n++) {
-				// (newz_i = newz[m][n])
+			for (size_t i = pnewdata->offsets[m]; i < pnewdata->offsets[m + 1]; i++) {
+				// (newz_i = newz[i])
 				// sample from p(z_i|z_-i, w)
-				int topic = inf_sampling(m, n);
-				newz[m][n] = topic;
+				int topic = inf_sampling(m, i);
+				newz.set(i, topic);
 			}
 		}
 	}
@@ -1015,41 +1597,116 @@ void model::inference() {
 	save_inf_model(dfile);
 }
 
-int model::inf_sampling(int m, int n) {
-	// remove z_i from the count variables
-	int topic = newz[m][n];
-	int w = pnewdata->docs[m]->words[n];
-	int _w = pnewdata->_docs[m]->words[n];
-	newnw[_w][topic] -= 1;
-	newnd[m][topic] -= 1;
-	newnwsum[topic] -= 1;
-	newndsum[m] -= 1;
+void model::inference_fixed() {
+	printf("Sampling %d iterations for inference with the fixed model on %d threads!\n", niters, nthreads);
 
-	double Vbeta = V * beta;
-	double Kalpha = K * alpha;
-	// do multinomial sampling via cumulative method
+	init_fixed();
+
+	// threads take the next batch of documents from a shared counter, so long documents do not hold up the rest
+	const int batch = 64;
+	atomic<int> next(0);
+	auto start = chrono::steady_clock::now();
+	utils::run_threads(max(nthreads, 1), [&](int) {
+		vector<double> pp(K);
+		vector<int> topics;
+		for (int first = next.fetch_add(batch); first < newM; first = next.fetch_add(batch)) {
+			for (int m = first; m < min(first + batch, newM); m++) {
+				// every document has a generator of its own, the result does not depend on the number of threads
+				uint64_t key = seed + (uint64_t) m * 0x9e3779b97f4a7c15ULL;
+				rng gen(splitmix64(key));
+				inf_fixed_doc(m, gen, topics, pp.data());
+			}
+		}
+	});
+	double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	printf("Gibbs sampling for inference completed!\n");
+	if (secs > 0.0) {
+		printf("Inference speed: %.0f documents/sec, %.0f tokens/sec\n", newM / secs,
+			   (double) pnewdata->ntokens() * niters / secs);
+	}
+
+	// the counts of the new words, for newphi
+	newnw.clear();
 	for (int k = 0; k < K; k++) {
-		p[k] = (nw[w][k] + newnw[_w][k] + beta) / (nwsum[k] + newnwsum[k] + Vbeta) *
-			   (newnd[m][k] + alpha) / (newndsum[m] + Kalpha);
+		newnwsum[k] = 0;
+	}
+	for (size_t i = 0; i < pnewdata->ntokens(); i++) {
+		newnw[pnewdata->_words[i]][newz.get(i)] += 1;
+		newnwsum[newz.get(i)] += 1;
 	}
-	// cumulate multinomial parameters
-	for (int k = 1; k < K; k++) {
-		p[k] += p[k - 1];
+
+	printf("Saving the inference outputs!\n");
+	compute_newtheta();
+	compute_newphi();
+	inf_liter = niters;
+	save_inf_model(dfile);
+}
+
+void model::init_fixed() {
+	// the counts of the model do not change, the new documents only see their own topics
+	fixedinvsum.resize(K);
+	for (int k = 0; k < K; k++) {
+		fixedinvsum[k] = 1.0 / (nwsum[k] + V * beta);
 	}
-	// scaled sample because of unnormalized p[]
-	double u = ((double) random() / RAND_MAX) * p[K - 1];
 
-	for (topic = 0; topic < K; topic++) {
-		if (p[topic] > u) {
-			break;
+	if (sampler == SAMPLER_ALIAS && !pinfalias) {
+		// phi is fixed, so are the alias tables of the word proposal
+		pinfalias = new aliasinf(this);
+		if (verbose) {
+			printf("Built the alias tables, %d Metropolis-Hastings steps per word\n", mhsteps);
 		}
 	}
+}
+
+void model::inf_fixed_doc(int m, rng &gen, vector<int> &topics, double *pp) {
+	size_t begin = pnewdata->offsets[m];
+	size_t n = pnewdata->offsets[m + 1] - begin;
+	topics.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		topics[i] = newz.get(begin + i);
+	}
+
+	sample_fixed(&pnewdata->words[begin], topics.data(), n, newnd[m], niters, gen, pp);
+
+	for (size_t i = 0; i < n; i++) {
+		newz.set(begin + i, topics[i]);
+	}
+}
+
+void model::sample_fixed(const int *words, int *topics, size_t n, ndcount *ndm, int iterations, rng &gen,
+						 double *pp) {
+	for (int iter = 0; iter < iterations; iter++) {
+		for (size_t i = 0; i < n; i++) {
+			int topic = topics[i];
+			ndm[topic] -= 1;
+			topic = draw_fixed(words[i], topic, ndm, topics, n, gen, pp);
+			ndm[topic] += 1;
+			topics[i] = topic;
+		}
+	}
+}
+
+int model::inf_sampling(int m, size_t i) {
+	// remove z_i from the count variables
+	int topic = newz.get(i);
+	int w = pnewdata->words[i];
+	int _w = pnewdata->_words[i];
+	newnw[_w][topic] -= 1;
+	newnd[m][topic] -= 1;
+	newnwsum[topic] -= 1;
+	newndsum[m] -= 1;
+	invsum[topic] = 1.0 / (nwsum[topic] + newnwsum[topic] + V * beta);
+
+	// do multinomial sampling via cumulative method
+	topic = pkernel(nw[w], newnw[_w], newnd[m], invsum, K, alpha, beta, generator.uniform(), p);
 
 	// add newly estimated z_i to count variables
 	newnw[_w][topic] += 1;
 	newnd[m][topic] += 1;
 	newnwsum[topic] += 1;
 	newndsum[m] += 1;
+	invsum[topic] = 1.0 / (nwsum[topic] + newnwsum[topic] + V * beta);
 
 	return topic;
 }
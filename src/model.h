@@ -32,8 +32,19 @@
 #ifndef    _MODEL_H
 #define    _MODEL_H
 
+#include <thread>
 #include "constants.h"
 #include "dataset.h"
+#include "sparselda.h"
+#include "aliaslda.h"
+#include "aliasinf.h"
+#include "groupedlda.h"
+#include "adlda.h"
+#include "blocklda.h"
+#include "kernel.h"
+#include "rng.h"
+#include "matrix.h"
+#include "topicarray.h"
 
 using namespace std;
 
@@ -48,6 +59,8 @@ public:
 	string phi_suffix;        // suffix for phi file
 	string others_suffix;    // suffix for file containing other parameters
 	string twords_suffix;    // suffix for file containing words-per-topics
+	string checkpoint_suffix;    // suffix for the binary checkpoint file
+	string infmodel_suffix;    // suffix for the inference-only model export
 
 	string dir;            // model directory
 	string dfile;        // data file
@@ -57,11 +70,15 @@ public:
 	// MODEL_STATUS_EST: estimating from scratch
 	// MODEL_STATUS_ESTC: continue to estimate the model from a previous one
 	// MODEL_STATUS_INF: do inference
+	// MODEL_STATUS_CONVERT: write the binary corpus of the training data
+	// MODEL_STATUS_EXPORT: write the inference model of a previously estimated one
+	// MODEL_STATUS_TOTEXT: write a binary theta or phi file as text
+	// MODEL_STATUS_SERVE: answer documents from stdin or a Unix domain socket with the resident model
 
 	dataset *ptrndata;    // pointer to training dataset object
 	dataset *pnewdata; // pointer to new dataset object
 
-	mapid2word id2word; // word map [int => string]
+	vocabulary id2word; // word map [int => string]
 
 	// --- model parameters and variables ---
 	int M; // dataset size (i.e., number of docs)
@@ -73,27 +90,60 @@ public:
 	int savestep; // saving period
 	int twords; // print out top words per each topic
 	int withrawstrs;
+	int sampler; // sampling algorithm: SAMPLER_DENSE, SAMPLER_SPARSE, SAMPLER_ALIAS or SAMPLER_GROUPED
+	int mhsteps; // number of Metropolis-Hastings steps per word for SAMPLER_ALIAS
+	int nthreads; // number of sampling threads
+	int parallel; // multi-threaded scheme: PARALLEL_ADLDA or PARALLEL_BLOCK
+	int syncstep; // number of documents per thread between merges of the nw deltas, 0: once per iteration
+	int kerneltype; // dense sampling kernel: KERNEL_AUTO, KERNEL_SCALAR, KERNEL_AVX2 or KERNEL_AVX512
+	int order; // token traversal order: ORDER_DOC, ORDER_SORTED or ORDER_WORD
+	int asyncsave; // write the savestep models on a background thread while sampling goes on
+	int format; // format of the theta and phi files: FORMAT_TEXT, FORMAT_BIN (float32), FORMAT_BIN64 or FORMAT_SPARSE
+	int topk; // FORMAT_SPARSE: keep at most topk entries per row, 0: all entries with a nonzero count
+	int fixedmodel; // inference with nw and nwsum frozen, each new document sampled on its own, on nthreads threads
+	string socketpath; // SERVE: Unix domain socket to listen on, empty for stdin and stdout
+	int serveout; // SERVE on stdin: the original stdout, for the answers
+	int maxbatch; // SERVE: at most this many documents are sampled together
+	double batchwindow; // SERVE: milliseconds a batch waits for more documents after its first one
+	int verbose; // print progress and status messages, errors and warnings are printed anyway
+	uint64_t seed; // random seed, worker thread t uses stream t + 1 of it
+	rng generator; // random number generator of the main thread (stream 0)
 
 	double *p; // temp variable for sampling
-	int **z; // topic assignments for words, size M x doc.size()
-	int **nw; // cwt[i][j]: number of instances of word/term i assigned to topic j, size V x K
-	int **nd; // na[i][j]: number of words in document i assigned to topic j, size M x K
+	double *invsum; // 1 / (nwsum[k] + V * beta), plus newnwsum[k] for inference, size K
+	dense_kernel pkernel; // dense sampling kernel selected by kerneltype
+	topicarray z; // topic assignments for words, parallel to ptrndata->words
+	vector<size_t> sortedindex; // ORDER_SORTED: corpus index of input token i after the sort, for saving
+	vector<size_t> wordtokens; // ORDER_WORD: corpus indices of the words, grouped by word id
+	vector<int> worddocs; // ORDER_WORD: document of each entry of wordtokens
+	vector<size_t> wordoffsets; // ORDER_WORD: start of word w in wordtokens, size V + 1
+	matrix<int> nw; // cwt[i][j]: number of instances of word/term i assigned to topic j, size V x K
+	matrix<ndcount> nd; // na[i][j]: number of words in document i assigned to topic j, size M x K
 	int *nwsum; // nwsum[j]: total number of words assigned to topic j, size K
 	int *ndsum; // nasum[i]: total number of words in document i, size M
-	double **theta; // theta: document-topic distributions, size M x K
-	double **phi; // phi: topic-word distributions, size K x V
+	matrix<double> theta; // theta: document-topic distributions, size M x K
+	matrix<double> phi; // phi: topic-word distributions, size K x V
+	sparselda *psparse; // bucketed sampler state, only for SAMPLER_SPARSE
+	aliaslda *palias; // alias tables, only for SAMPLER_ALIAS
+	aliasinf *pinfalias; // alias tables of the fixed model, only for inference with SAMPLER_ALIAS
+	groupedlda *pgrouped; // repeated-word groups, only for SAMPLER_GROUPED
+	adlda *padlda; // worker threads, only if nthreads > 1 and PARALLEL_ADLDA
+	blocklda *pblock; // block partitioning, only if nthreads > 1 and PARALLEL_BLOCK
+	model *psaved; // snapshot of z and the counts being saved by saver, only with asyncsave
+	thread saver; // background save of psaved
 
 	// for inference only
 	int inf_liter;
 	int newM;
 	int newV;
-	int **newz;
-	int **newnw;
-	int **newnd;
+	topicarray newz;
+	matrix<int> newnw;
+	matrix<ndcount> newnd;
 	int *newnwsum;
 	int *newndsum;
-	double **newtheta;
-	double **newphi;
+	matrix<double> newtheta;
+	matrix<double> newphi;
+	vector<double> fixedinvsum; // fixed-model inference: 1 / (nwsum[k] + V * beta), size K
 	// --------------------------------------
 
 	model() {
@@ -119,8 +169,15 @@ public:
 	// model_name.theta: document-topic distributions
 	// model_name.phi: topic-word distributions
 	// model_name.others: containing other parameters of the model (alpha, beta, M, V, K)
+	// model_name.ckpt: binary checkpoint for a quick -estc or -inf start
 	int save_model(const string &in_model_name);
 
+	// snapshot z and the counts into psaved and save it on the saver thread, after the previous save is done
+	void save_model_async(const string &in_model_name);
+
+	// wait for the background save, if any
+	void join_save();
+
 	int save_model_tassign(const string &filename);
 
 	int save_model_theta(const string &filename);
@@ -131,6 +188,23 @@ public:
 
 	int save_model_twords(const string &filename);
 
+	// binary checkpoint model_name.ckpt: z, ptrndata and the hyperparameters, stamped with the .tassign file
+	// written along with it; loading maps it and copies the arrays without any parsing, like load_model it leaves
+	// the counts to init_counts
+	int save_model_checkpoint(const string &in_model_name);
+
+	// returns 1 if there is no checkpoint or it does not match the .tassign and .others files
+	int load_model_checkpoint(const string &in_model_name);
+
+	// inference-only export model_name.infmodel: the sparse nw, nwsum, the word map and the hyperparameters,
+	// all that -inf needs; loading it sets K, V, alpha and beta and does not need the .others file
+	int save_infmodel(const string &in_model_name);
+
+	int load_infmodel(const string &in_model_name);
+
+	// the same from an inference model in memory, e.g. a mapped .infmodel file, filename is for the messages
+	int load_infmodel(const char *data, size_t size, const string &filename);
+
 	// saving inference outputs
 	int save_inf_model(const string &in_model_name);
 
@@ -144,15 +218,54 @@ public:
 
 	int save_inf_model_twords(const string &filename);
 
+	// write rows x cols values as text, "%f " each and one row per line, or to filename.bin with a binary format;
+	// FORMAT_SPARSE writes filename.sparse, the smoothing of each row followed by the column:value pairs above it
+	int save_rows(const string &filename, const matrix<double> &values, int rows, int cols,
+				  const vector<double> &smoothing);
+
+	// check that no document is too long for the ndcount type of nd and newnd
+	int check_ndcount(dataset *pdata);
+
+	// load nw, nwsum and id2word for inference, from the inference export, the checkpoint or the .tassign file
+	int load_inf_counts();
+
+	// read model_name.others for inference, which may only be missing if there is an inference export
+	int read_inf_others();
+
+	// whether model_name.infmodel exists and was exported from the .tassign and .others files next to it; an
+	// export without them is trusted as it is
+	bool infmodel_current(const string &in_model_name);
+
 	// init for estimation
 	int init_est();
 
+	// allocate the counts and draw the initial z for the corpus in ptrndata, then init_sampler
+	void init_est_corpus();
+
 	int init_estc();
 
+	// count nw and nwsum from z, and nd and ndsum too with docs
+	void init_counts(bool docs);
+
+	// set up the state of the selected sampler once the count variables are in place
+	void init_sampler();
+
+	// arrange the corpus for the traversal order, sorts the words of each document or builds wordtokens
+	void init_order();
+
+	// select the dense sampling kernel and fill in invsum
+	void init_kernel();
+
+	// set pkernel from kerneltype, falling back to the scalar kernel
+	void select_kernel();
+
 	// estimate LDA model using Gibbs sampling
 	void estimate();
 
-	int sampling(int m, int n);
+	// the niters iterations of estimate, with the savestep saves but without the final one
+	void sample_iterations();
+
+	int sampling(int m, size_t i);
 
 	void compute_theta();
 
@@ -164,7 +277,32 @@ public:
 	// inference for new (unseen) data based on the estimated LDA model
 	void inference();
 
-	int inf_sampling(int m, int n);
+	int inf_sampling(int m, size_t i);
+
+	// answer documents until the end of stdin or until the socket server is stopped
+	int serve();
+
+	// inference with the fixed model: all iterations of a document at once, documents spread over nthreads
+	void inference_fixed();
+
+	// fill in fixedinvsum, and build pinfalias for SAMPLER_ALIAS
+	void init_fixed();
+
+	// niters iterations over new document m, only newz and its newnd row change; newndsum[m] stays the length
+	void inf_fixed_doc(int m, rng &gen, vector<int> &topics, double *pp);
+
+	// iterations of fixed-model sampling over the n words of a document, with their topics and the
+	// document-topic counts ndm; safe to run on several threads at once
+	void sample_fixed(const int *words, int *topics, size_t n, ndcount *ndm, int iterations, rng &gen, double *pp);
+
+	// a new topic for a token of word w and topic s0 with the fixed model, ndm without the token; topics are the
+	// n topics of its document, for the doc proposal of pinfalias
+	int draw_fixed(int w, int s0, const ndcount *ndm, const int *topics, size_t n, rng &gen, double *pp) {
+		if (pinfalias) {
+			return pinfalias->sample(w, s0, ndm, topics, n, gen);
+		}
+		return pkernel(nw[w], nullptr, ndm, fixedinvsum.data(), K, alpha, beta, gen.uniform(), pp);
+	}
 
 	void compute_newtheta();
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include "perfcounter.h"
+
+#ifdef __linux__
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+perfcounter::perfcounter() {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.inherit = 1; // count the sampling threads too, they add to the total when they are joined
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	base = 0;
+}
+
+perfcounter::~perfcounter() {
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+long long perfcounter::value() {
+	long long count = 0;
+	if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+		count = 0;
+	}
+	return count;
+}
+
+void perfcounter::start() {
+	if (fd >= 0) {
+		base = value();
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+long long perfcounter::stop() {
+	if (fd < 0) {
+		return 0;
+	}
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	return value() - base;
+}
+
+#else
+
+perfcounter::perfcounter() {
+	fd = -1;
+	base = 0;
+}
+
+perfcounter::~perfcounter() {
+}
+
+long long perfcounter::value() {
+	return 0;
+}
+
+void perfcounter::start() {
+}
+
+long long perfcounter::stop() {
+	return 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _PERFCOUNTER_H
+#define    _PERFCOUNTER_H
+
+// Hardware cache-miss counter of the calling process (and of the threads it starts later), read through
+// perf_event_open on Linux. Where the counter cannot be opened, e.g. on other systems, without a PMU or with a
+// restrictive perf_event_paranoid setting, available() is false and stop() returns 0.
+class perfcounter {
+public:
+	perfcounter();
+
+	~perfcounter();
+
+	perfcounter(const perfcounter &) = delete;
+
+	perfcounter &operator=(const perfcounter &) = delete;
+
+	bool available() const {
+		return fd >= 0;
+	}
+
+	// enable the counter
+	void start();
+
+	// disable the counter and return the number of cache misses since start()
+	long long stop();
+
+private:
+	int fd;
+	long long base; // counter value at start(), the counts of joined threads are never reset
+
+	long long value();
+};
+
+#endif
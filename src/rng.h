@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "Scrambled linear pseudorandom number generators" by David Blackman and Sebastiano Vigna
+ *   (ACM TOMS 2021), http://prng.di.unimi.it/
+ * + "PCG: A family of simple fast space-efficient statistically good algorithms for random number
+ *   generation" by Melissa E. O'Neill (2014), http://www.pcg-random.org/
+ */
+
+#ifndef    _RNG_H
+#define    _RNG_H
+
+#include <cstdint>
+
+using namespace std;
+
+// splitmix64, only used to expand a seed into generator state
+inline uint64_t splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// xoshiro256**, 256 bits of state, period 2^256 - 1
+class xoshiro256ss {
+public:
+	// independent stream number <stream> of the generator seeded with <seed>, streams are 2^128 draws apart
+	explicit xoshiro256ss(uint64_t seed = 0, uint64_t stream = 0) {
+		for (auto &x : s) {
+			x = splitmix64(seed);
+		}
+		for (uint64_t i = 0; i < stream; i++) {
+			jump();
+		}
+	}
+
+	uint64_t next() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	// advance the state by 2^128 draws
+	void jump() {
+		static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+										0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+		uint64_t t[4] = {0, 0, 0, 0};
+		for (uint64_t j : JUMP) {
+			for (int b = 0; b < 64; b++) {
+				if (j & (1ULL << b)) {
+					for (int i = 0; i < 4; i++) {
+						t[i] ^= s[i];
+					}
+				}
+				next();
+			}
+		}
+		for (int i = 0; i < 4; i++) {
+			s[i] = t[i];
+		}
+	}
+
+	// uniform double in [0, 1) from the upper 53 bits
+	double uniform() {
+		return (double) (next() >> 11) * 0x1.0p-53;
+	}
+
+	// uniform integer in [0, n), n < 2^32 (multiply-shift, no division)
+	int below(int n) {
+		return (int) (((next() >> 32) * (uint64_t) n) >> 32);
+	}
+
+private:
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+// PCG-XSH-RR 64/32 with a selectable stream (increment)
+class pcg32 {
+public:
+	explicit pcg32(uint64_t seed = 0, uint64_t stream = 0) {
+		inc = (stream << 1) | 1;
+		state = 0;
+		next32();
+		state += splitmix64(seed);
+		next32();
+	}
+
+	uint32_t next32() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+		uint32_t rot = (uint32_t) (old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+
+	uint64_t next() {
+		uint64_t hi = next32();
+		return (hi << 32) | next32();
+	}
+
+	double uniform() {
+		return (double) (next() >> 11) * 0x1.0p-53;
+	}
+
+	int below(int n) {
+		return (int) (((uint64_t) next32() * (uint64_t) n) >> 32);
+	}
+
+private:
+	uint64_t state;
+	uint64_t inc;
+};
+
+// the generator used by all samplers, build with -DGIBBSLDA_RNG_PCG to switch to PCG
+#ifdef GIBBSLDA_RNG_PCG
+typedef pcg32 rng;
+#else
+typedef xoshiro256ss rng;
+#endif
+
+#endif
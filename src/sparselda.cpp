@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include "dataset.h"
+#include "model.h"
+#include "sparselda.h"
+
+using namespace std;
+
+sparselda::sparselda(model *pmodel) {
+	this->pmodel = pmodel;
+	K = pmodel->K;
+	alpha = pmodel->alpha;
+	beta = pmodel->beta;
+	Vbeta = pmodel->V * beta;
+
+	ssum = 0.0;
+	rsum = 0.0;
+	coef = new double[K];
+	q = new double[K];
+	dtopics = new int[K];
+	dpos = new int[K];
+	ndtopics = 0;
+
+	for (int k = 0; k < K; k++) {
+		coef[k] = alpha / (pmodel->nwsum[k] + Vbeta);
+		dpos[k] = -1;
+	}
+
+	// collect the nonzero topics of every word from the current counts
+	wtopics = new vector<int>[pmodel->V];
+	for (int w = 0; w < pmodel->V; w++) {
+		for (int k = 0; k < K; k++) {
+			if (pmodel->nw[w][k] > 0) {
+				wtopics[w].push_back(k);
+			}
+		}
+	}
+}
+
+sparselda::~sparselda() {
+	delete[] coef;
+	delete[] q;
+	delete[] dtopics;
+	delete[] dpos;
+	delete[] wtopics;
+}
+
+void sparselda::begin_iteration() {
+	ssum = 0.0;
+	for (int k = 0; k < K; k++) {
+		ssum += alpha * beta / (pmodel->nwsum[k] + Vbeta);
+	}
+}
+
+void sparselda::sample_doc(int m) {
+	size_t begin = pmodel->ptrndata->offsets[m];
+	size_t end = pmodel->ptrndata->offsets[m + 1];
+	topicarray &z = pmodel->z;
+	ndcount *ndm = pmodel->nd[m];
+
+	// enter document m: collect its nonzero topics and fill in the document bucket and coefficients
+	rsum = 0.0;
+	ndtopics = 0;
+	for (size_t i = begin; i < end; i++) {
+		int topic = z.get(i);
+		if (dpos[topic] < 0) {
+			dpos[topic] = ndtopics;
+			dtopics[ndtopics++] = topic;
+
+			double denom = pmodel->nwsum[topic] + Vbeta;
+			rsum += ndm[topic] * beta / denom;
+			coef[topic] = (ndm[topic] + alpha) / denom;
+		}
+	}
+
+	for (size_t i = begin; i < end; i++) {
+		z.set(i, sampling(m, i));
+	}
+
+	// leave document m: the coefficients fall back to the smoothing-only value
+	for (int i = 0; i < ndtopics; i++) {
+		int topic = dtopics[i];
+		coef[topic] = alpha / (pmodel->nwsum[topic] + Vbeta);
+		dpos[topic] = -1;
+	}
+	ndtopics = 0;
+}
+
+void sparselda::remove_topic(int m, int w, int topic) {
+	int nk = pmodel->nwsum[topic];
+	int ndk = pmodel->nd[m][topic];
+
+	ssum -= alpha * beta / (nk + Vbeta);
+	rsum -= ndk * beta / (nk + Vbeta);
+
+	pmodel->nw[w][topic] -= 1;
+	pmodel->nd[m][topic] -= 1;
+	pmodel->nwsum[topic] -= 1;
+	pmodel->ndsum[m] -= 1;
+	nk--;
+	ndk--;
+
+	double denom = nk + Vbeta;
+	ssum += alpha * beta / denom;
+	rsum += ndk * beta / denom;
+	coef[topic] = (ndk + alpha) / denom;
+
+	if (pmodel->nw[w][topic] == 0) {
+		vector<int> &wt = wtopics[w];
+		for (size_t i = 0; i < wt.size(); i++) {
+			if (wt[i] == topic) {
+				wt[i] = wt.back();
+				wt.pop_back();
+				break;
+			}
+		}
+	}
+
+	if (ndk == 0) {
+		// swap the last nonzero topic of the document into the freed slot
+		int i = dpos[topic];
+		int last = dtopics[--ndtopics];
+		dtopics[i] = last;
+		dpos[last] = i;
+		dpos[topic] = -1;
+	}
+}
+
+void sparselda::add_topic(int m, int w, int topic) {
+	int nk = pmodel->nwsum[topic];
+	int ndk = pmodel->nd[m][topic];
+
+	ssum -= alpha * beta / (nk + Vbeta);
+	rsum -= ndk * beta / (nk + Vbeta);
+
+	pmodel->nw[w][topic] += 1;
+	pmodel->nd[m][topic] += 1;
+	pmodel->nwsum[topic] += 1;
+	pmodel->ndsum[m] += 1;
+	nk++;
+	ndk++;
+
+	double denom = nk + Vbeta;
+	ssum += alpha * beta / denom;
+	rsum += ndk * beta / denom;
+	coef[topic] = (ndk + alpha) / denom;
+
+	if (pmodel->nw[w][topic] == 1) {
+		wtopics[w].push_back(topic);
+	}
+
+	if (ndk == 1) {
+		dpos[topic] = ndtopics;
+		dtopics[ndtopics++] = topic;
+	}
+}
+
+/**
+ * Draws z_i from the same full conditional as model::sampling, but decomposed into the s, r and q buckets. The
+ * normalizing term 1 / (ndsum[m] + K * alpha) is the same for all topics and is left out.
+ */
+int sparselda::sampling(int m, size_t i) {
+	int topic = pmodel->z.get(i);
+	int w = pmodel->ptrndata->words[i];
+	remove_topic(m, w, topic);
+
+	// topic-word bucket, only over the nonzero topics of word w
+	const vector<int> &wt = wtopics[w];
+	int *nww = pmodel->nw[w];
+	double qsum = 0.0;
+	for (size_t i = 0; i < wt.size(); i++) {
+		q[i] = coef[wt[i]] * nww[wt[i]];
+		qsum += q[i];
+	}
+
+	double u = pmodel->generator.uniform() * (ssum + rsum + qsum);
+
+	if (u < qsum) {
+		size_t i = 0;
+		for (; i < wt.size() - 1; i++) {
+			u -= q[i];
+			if (u <= 0.0) {
+				break;
+			}
+		}
+		topic = wt[i];
+
+	} else if (u - qsum < rsum && ndtopics > 0) {
+		// document bucket, only over the nonzero topics of document m
+		u -= qsum;
+		ndcount *ndm = pmodel->nd[m];
+		int i = 0;
+		for (; i < ndtopics - 1; i++) {
+			u -= ndm[dtopics[i]] * beta / (pmodel->nwsum[dtopics[i]] + Vbeta);
+			if (u <= 0.0) {
+				break;
+			}
+		}
+		topic = dtopics[i];
+
+	} else {
+		// smoothing bucket, dense but its mass is small
+		u -= qsum + rsum;
+		for (topic = 0; topic < K - 1; topic++) {
+			u -= alpha * beta / (pmodel->nwsum[topic] + Vbeta);
+			if (u <= 0.0) {
+				break;
+			}
+		}
+	}
+
+	add_topic(m, w, topic);
+
+	return topic;
+}
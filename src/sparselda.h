@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/*
+ * References:
+ * + "Efficient methods for topic model inference on streaming document
+ *   collections" by Limin Yao, David Mimno and Andrew McCallum (KDD 2009)
+ */
+
+#ifndef    _SPARSELDA_H
+#define    _SPARSELDA_H
+
+#include <vector>
+
+using namespace std;
+
+class model;
+
+// SparseLDA sampler
+//
+// The full conditional is split into three buckets that share the denominator (nwsum[k] + V * beta):
+//   s = sum_k alpha * beta / (nwsum[k] + Vbeta)                  (smoothing, dense but rarely hit)
+//   r = sum_k nd[m][k] * beta / (nwsum[k] + Vbeta)               (document, nonzero nd[m][k] only)
+//   q = sum_k (nd[m][k] + alpha) * nw[w][k] / (nwsum[k] + Vbeta) (topic-word, nonzero nw[w][k] only)
+// s and r are kept up to date as the counts change, so the per token cost depends on the number of
+// nonzero topics of the document and of the word instead of on K.
+class sparselda {
+public:
+	explicit sparselda(model *pmodel);
+
+	~sparselda();
+
+	// recompute the smoothing bucket from scratch, called once per iteration to avoid drift
+	void begin_iteration();
+
+	// resample all words of document m, updates z and the count variables
+	void sample_doc(int m);
+
+private:
+	model *pmodel;
+	int K;
+	double alpha, beta, Vbeta;
+
+	double ssum; // smoothing bucket mass
+	double rsum; // document bucket mass
+	double *coef; // (nd[m][k] + alpha) / (nwsum[k] + Vbeta) for the current document, alpha / (...) otherwise
+	double *q; // temp variable for the topic-word bucket, one entry per nonzero topic of the word
+
+	vector<int> *wtopics; // nonzero topics of nw[w], size V
+	int *dtopics; // nonzero topics of nd[m] for the current document
+	int *dpos; // position of a topic in dtopics, -1 if absent, size K
+	int ndtopics;
+
+	void remove_topic(int m, int w, int topic);
+
+	void add_topic(int m, int w, int topic);
+
+	// resample word i of the corpus, which belongs to document m
+	int sampling(int m, size_t i);
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include "utils.h"
+#include "textwriter.h"
+
+using namespace std;
+
+int textwriter::write_rows(const string &filename, size_t nrows, size_t rowbytes,
+						   const function<void(size_t, textbuffer &)> &format) {
+	FILE *fout = fopen(filename.c_str(), "w");
+	if (!fout) {
+		printf("Cannot open file %s to save!\n", filename.c_str());
+		return 1;
+	}
+
+	int nthreads = max(1, (int) thread::hardware_concurrency());
+	size_t step = max((size_t) 1, chunkbytes / max(rowbytes, (size_t) 1));
+	nthreads = (int) min((size_t) nthreads, (nrows + step - 1) / step);
+	vector<textbuffer> buffers(max(nthreads, 1));
+
+	// every round formats nthreads consecutive chunks of rows, then writes them one after the other
+	for (size_t begin = 0; begin < nrows; begin += nthreads * step) {
+		utils::run_threads(nthreads, [&](int t) {
+			textbuffer &buffer = buffers[t];
+			buffer.clear();
+			size_t first = min(nrows, begin + t * step);
+			size_t last = min(nrows, first + step);
+			for (size_t row = first; row < last; row++) {
+				format(row, buffer);
+			}
+		});
+		for (int t = 0; t < nthreads; t++) {
+			fwrite(buffers[t].data.data(), 1, buffers[t].size, fout);
+		}
+	}
+
+	int failed = ferror(fout);
+	if (fclose(fout) != 0) {
+		failed = 1;
+	}
+	if (failed) {
+		printf("Cannot write file %s!\n", filename.c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _TEXTWRITER_H
+#define    _TEXTWRITER_H
+
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Growable character buffer that numbers are formatted into with to_chars
+class textbuffer {
+public:
+	vector<char> data;
+	size_t size;
+
+	textbuffer() {
+		size = 0;
+	}
+
+	void clear() {
+		size = 0;
+	}
+
+	// make room for n more characters
+	void reserve(size_t n) {
+		if (size + n > data.size()) {
+			data.resize(max(size + n, data.size() * 2));
+		}
+	}
+
+	void put(char c) {
+		reserve(1);
+		data[size++] = c;
+	}
+
+	void put(int value) {
+		reserve(16);
+		size = to_chars(data.data() + size, data.data() + data.size(), value).ptr - data.data();
+	}
+
+	// the same characters as printf("%f", value)
+	void put(double value) {
+		reserve(352);
+		size = to_chars(data.data() + size, data.data() + data.size(), value, chars_format::fixed, 6).ptr -
+			   data.data();
+	}
+
+	// the shortest characters that read back as value
+	void put_shortest(double value) {
+		reserve(32);
+		size = to_chars(data.data() + size, data.data() + data.size(), value).ptr - data.data();
+	}
+};
+
+class textwriter {
+public:
+	// write rows 0 .. nrows - 1 to filename, format(row, buffer) appends one row to buffer;
+	// rows are formatted in parallel chunks of about chunkbytes / rowbytes rows and written in order
+	static int write_rows(const string &filename, size_t nrows, size_t rowbytes,
+						  const function<void(size_t, textbuffer &)> &format);
+
+	static const size_t chunkbytes = 1 << 22;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _TOPICARRAY_H
+#define    _TOPICARRAY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Topic assignments of all words of a corpus, stored with the smallest integer type that holds K topics:
+// 1 byte for K <= 256, 2 bytes for K <= 65536 and 4 bytes otherwise.
+class topicarray {
+public:
+	int width; // bytes per topic
+
+	topicarray() {
+		width = 4;
+	}
+
+	// pick the width for K topics and drop the current contents
+	void init(int K) {
+		width = K <= 256 ? 1 : (K <= 65536 ? 2 : 4);
+		z8.clear();
+		z16.clear();
+		z32.clear();
+	}
+
+	size_t size() const {
+		return width == 1 ? z8.size() : (width == 2 ? z16.size() : z32.size());
+	}
+
+	void resize(size_t n) {
+		if (width == 1) {
+			z8.resize(n);
+		} else if (width == 2) {
+			z16.resize(n);
+		} else {
+			z32.resize(n);
+		}
+	}
+
+	void push_back(int topic) {
+		if (width == 1) {
+			z8.push_back((uint8_t) topic);
+		} else if (width == 2) {
+			z16.push_back((uint16_t) topic);
+		} else {
+			z32.push_back(topic);
+		}
+	}
+
+	// the packed topics, size() * width bytes
+	void *data() {
+		return width == 1 ? (void *) z8.data() : (width == 2 ? (void *) z16.data() : (void *) z32.data());
+	}
+
+	const void *data() const {
+		return width == 1 ? (const void *) z8.data() : (width == 2 ? (const void *) z16.data() : (const void *) z32.data());
+	}
+
+	int get(size_t i) const {
+		if (width == 1) {
+			return z8[i];
+		} else if (width == 2) {
+			return z16[i];
+		}
+		return z32[i];
+	}
+
+	void set(size_t i, int topic) {
+		if (width == 1) {
+			z8[i] = (uint8_t) topic;
+		} else if (width == 2) {
+			z16[i] = (uint16_t) topic;
+		} else {
+			z32[i] = topic;
+		}
+	}
+
+private:
+	vector<uint8_t> z8;
+	vector<uint16_t> z16;
+	vector<int> z32;
+};
+
+#endif
@@ -24,7 +24,9 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
-#include "strtokenizer.h"
+#include <sys/stat.h>
+#include "viewtokenizer.h"
+#include "linereader.h"
 #include "utils.h"
 #include "model.h"
 
@@ -41,6 +43,21 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 	int savestep = 0;
 	int twords = 0;
 	int withrawdata = 0;
+	int sampler = -1;
+	int mhsteps = 0;
+	int nthreads = 0;
+	int syncstep = -1;
+	int parallel = -1;
+	int kerneltype = -1;
+	int order = -1;
+	int asyncsave = 0;
+	int format = -1;
+	int topk = 0;
+	int fixedmodel = 0;
+	string socketpath;
+	int maxbatch = 0;
+	double batchwindow = -1.0;
+	string seed;
 
 	char *endptr = nullptr;
 	int i = 0;
@@ -50,6 +67,18 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 		if (arg == "-est") {
 			model_status = MODEL_STATUS_EST;
 
+		} else if (arg == "-convert") {
+			model_status = MODEL_STATUS_CONVERT;
+
+		} else if (arg == "-serve") {
+			model_status = MODEL_STATUS_SERVE;
+
+		} else if (arg == "-totext") {
+			model_status = MODEL_STATUS_TOTEXT;
+
+		} else if (arg == "-export") {
+			model_status = MODEL_STATUS_EXPORT;
+
 		} else if (arg == "-estc") {
 			model_status = MODEL_STATUS_ESTC;
 
@@ -86,6 +115,105 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 		} else if (arg == "-withrawdata") {
 			withrawdata = 1;
 
+		} else if (arg == "-sampler") {
+			string name = argv[++i];
+			if (name == "dense") {
+				sampler = SAMPLER_DENSE;
+			} else if (name == "sparse") {
+				sampler = SAMPLER_SPARSE;
+			} else if (name == "alias") {
+				sampler = SAMPLER_ALIAS;
+			} else if (name == "grouped") {
+				sampler = SAMPLER_GROUPED;
+			} else {
+				printf("Unknown sampler %s, use dense, sparse, alias or grouped!\n", name.c_str());
+				return 1;
+			}
+
+		} else if (arg == "-mhsteps") {
+			mhsteps = (int)strtol(argv[++i], &endptr, 10);
+
+		} else if (arg == "-nthreads") {
+			nthreads = (int)strtol(argv[++i], &endptr, 10);
+
+		} else if (arg == "-parallel") {
+			string name = argv[++i];
+			if (name == "adlda") {
+				parallel = PARALLEL_ADLDA;
+			} else if (name == "block") {
+				parallel = PARALLEL_BLOCK;
+			} else {
+				printf("Unknown parallel scheme %s, use adlda or block!\n", name.c_str());
+				return 1;
+			}
+
+		} else if (arg == "-kernel") {
+			string name = argv[++i];
+			if (name == "auto") {
+				kerneltype = KERNEL_AUTO;
+			} else if (name == "scalar") {
+				kerneltype = KERNEL_SCALAR;
+			} else if (name == "avx2") {
+				kerneltype = KERNEL_AVX2;
+			} else if (name == "avx512") {
+				kerneltype = KERNEL_AVX512;
+			} else {
+				printf("Unknown kernel %s, use auto, scalar, avx2 or avx512!\n", name.c_str());
+				return 1;
+			}
+
+		} else if (arg == "-order") {
+			string name = argv[++i];
+			if (name == "doc") {
+				order = ORDER_DOC;
+			} else if (name == "sorted") {
+				order = ORDER_SORTED;
+			} else if (name == "word") {
+				order = ORDER_WORD;
+			} else {
+				printf("Unknown order %s, use doc, sorted or word!\n", name.c_str());
+				return 1;
+			}
+
+		} else if (arg == "-format") {
+			string name = argv[++i];
+			if (name == "text") {
+				format = FORMAT_TEXT;
+			} else if (name == "bin") {
+				format = FORMAT_BIN;
+			} else if (name == "bin64") {
+				format = FORMAT_BIN64;
+			} else if (name == "sparse") {
+				format = FORMAT_SPARSE;
+			} else {
+				printf("Unknown format %s, use text, bin, bin64 or sparse!\n", name.c_str());
+				return 1;
+			}
+
+		} else if (arg == "-topk") {
+			topk = (int)strtol(argv[++i], &endptr, 10);
+
+		} else if (arg == "-socket") {
+			socketpath = argv[++i];
+
+		} else if (arg == "-maxbatch") {
+			maxbatch = (int)strtol(argv[++i], &endptr, 10);
+
+		} else if (arg == "-batchwindow") {
+			batchwindow = strtod(argv[++i], &endptr);
+
+		} else if (arg == "-fixed") {
+			fixedmodel = 1;
+
+		} else if (arg == "-asyncsave") {
+			asyncsave = 1;
+
+		} else if (arg == "-seed") {
+			seed = argv[++i];
+
+		} else if (arg == "-syncstep") {
+			syncstep = (int)strtol(argv[++i], &endptr, 10);
+
 		} else {
 			// any more?
 		}
@@ -128,6 +256,46 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 			pmodel->twords = twords;
 		}
 
+		if (sampler >= 0) {
+			pmodel->sampler = sampler;
+		}
+
+		if (mhsteps > 0) {
+			pmodel->mhsteps = mhsteps;
+		}
+
+		if (nthreads > 0) {
+			pmodel->nthreads = nthreads;
+		}
+
+		if (parallel >= 0) {
+			pmodel->parallel = parallel;
+		}
+
+		if (syncstep >= 0) {
+			pmodel->syncstep = syncstep;
+		}
+
+		if (kerneltype >= 0) {
+			pmodel->kerneltype = kerneltype;
+		}
+
+		if (order >= 0) {
+			pmodel->order = order;
+		}
+
+		if (asyncsave > 0) {
+			pmodel->asyncsave = asyncsave;
+		}
+
+		if (format >= 0) {
+			pmodel->format = format;
+		}
+
+		if (topk > 0) {
+			pmodel->topk = topk;
+		}
+
 		pmodel->dfile = dfile;
 
 		string::size_type idx = dfile.find_last_of('/');
@@ -173,6 +341,46 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 			pmodel->twords = twords;
 		}
 
+		if (sampler >= 0) {
+			pmodel->sampler = sampler;
+		}
+
+		if (mhsteps > 0) {
+			pmodel->mhsteps = mhsteps;
+		}
+
+		if (nthreads > 0) {
+			pmodel->nthreads = nthreads;
+		}
+
+		if (parallel >= 0) {
+			pmodel->parallel = parallel;
+		}
+
+		if (syncstep >= 0) {
+			pmodel->syncstep = syncstep;
+		}
+
+		if (kerneltype >= 0) {
+			pmodel->kerneltype = kerneltype;
+		}
+
+		if (order >= 0) {
+			pmodel->order = order;
+		}
+
+		if (asyncsave > 0) {
+			pmodel->asyncsave = asyncsave;
+		}
+
+		if (format >= 0) {
+			pmodel->format = format;
+		}
+
+		if (topk > 0) {
+			pmodel->topk = topk;
+		}
+
 		// read <model>.others file to assign values for ntopics, alpha, beta, etc.
 		if (read_and_parse(pmodel->dir + pmodel->model_name + pmodel->others_suffix, pmodel)) {
 			return 1;
@@ -221,17 +429,160 @@ int utils::parse_args(int argc, char **argv, model *pmodel) {
 			pmodel->withrawstrs = withrawdata;
 		}
 
+		if (nthreads > 0) {
+			pmodel->nthreads = nthreads;
+		}
+
+		if (fixedmodel > 0) {
+			pmodel->fixedmodel = fixedmodel;
+		}
+
+		if (sampler == SAMPLER_DENSE || sampler == SAMPLER_ALIAS) {
+			pmodel->sampler = sampler;
+		} else if (sampler >= 0) {
+			printf("Inference uses the dense or alias sampler, using the dense one!\n");
+		}
+
+		if (mhsteps > 0) {
+			pmodel->mhsteps = mhsteps;
+		}
+
+		if (kerneltype >= 0) {
+			pmodel->kerneltype = kerneltype;
+		}
+
+		if (format >= 0) {
+			pmodel->format = format;
+		}
+
+		if (topk > 0) {
+			pmodel->topk = topk;
+		}
+
+		// read <model>.others file to assign values for ntopics, alpha, beta, etc.
+		if (pmodel->read_inf_others()) {
+			return 1;
+		}
+	}
+
+	if (model_status == MODEL_STATUS_SERVE) {
+		if (dir.empty()) {
+			printf("Please specify model directory!\n");
+			return 1;
+		}
+
+		if (model_name.empty()) {
+			printf("Please specify model name to serve!\n");
+			return 1;
+		}
+
+		pmodel->model_status = model_status;
+
+		if (dir[dir.size() - 1] != '/') {
+			dir += "/";
+		}
+		pmodel->dir = dir;
+
+		pmodel->model_name = model_name;
+
+		pmodel->socketpath = socketpath;
+
+		if (sampler == SAMPLER_DENSE || sampler == SAMPLER_ALIAS) {
+			pmodel->sampler = sampler;
+		} else if (sampler >= 0) {
+			printf("Inference uses the dense or alias sampler, using the dense one!\n");
+		}
+
+		if (mhsteps > 0) {
+			pmodel->mhsteps = mhsteps;
+		}
+
+		if (maxbatch > 0) {
+			pmodel->maxbatch = maxbatch;
+		}
+
+		if (batchwindow >= 0.0) {
+			pmodel->batchwindow = batchwindow;
+		}
+
+		if (niters > 0) {
+			pmodel->niters = niters;
+		} else {
+			// default number of Gibbs sampling iterations for doing inference
+			pmodel->niters = 20;
+		}
+
+		if (nthreads > 0) {
+			pmodel->nthreads = nthreads;
+		}
+
+		if (topk > 0) {
+			pmodel->topk = topk;
+		}
+
+		if (kerneltype >= 0) {
+			pmodel->kerneltype = kerneltype;
+		}
+
+		// read <model>.others file to assign values for ntopics, alpha, beta, etc.
+		if (pmodel->read_inf_others()) {
+			return 1;
+		}
+	}
+
+	if (model_status == MODEL_STATUS_EXPORT) {
+		if (dir.empty()) {
+			printf("Please specify model directory!\n");
+			return 1;
+		}
+
+		if (model_name.empty()) {
+			printf("Please specify model name to export for inference!\n");
+			return 1;
+		}
+
+		pmodel->model_status = model_status;
+
+		if (dir[dir.size() - 1] != '/') {
+			dir += "/";
+		}
+		pmodel->dir = dir;
+
+		pmodel->model_name = model_name;
+
 		// read <model>.others file to assign values for ntopics, alpha, beta, etc.
 		if (read_and_parse(pmodel->dir + pmodel->model_name + pmodel->others_suffix, pmodel)) {
 			return 1;
 		}
 	}
 
+	if (model_status == MODEL_STATUS_CONVERT || model_status == MODEL_STATUS_TOTEXT) {
+		if (dfile.empty()) {
+			printf("Please specify the input data file to convert!\n");
+			return 1;
+		}
+
+		pmodel->model_status = model_status;
+		pmodel->dfile = dfile;
+
+		string::size_type idx = dfile.find_last_of('/');
+		if (idx == string::npos) {
+			pmodel->dir = "./";
+		} else {
+			pmodel->dir = dfile.substr(0, idx + 1);
+			pmodel->dfile = dfile.substr(idx + 1, dfile.size() - pmodel->dir.size());
+		}
+	}
+
 	if (model_status == MODEL_STATUS_UNKNOWN) {
-		printf("Please specify the task you would like to perform (-est/-estc/-inf)!\n");
+		printf("Please specify the task you would like to perform (-est/-estc/-inf/-convert/-export/-totext/-serve)!\n");
 		return 1;
 	}
 
+	if (!seed.empty()) {
+		pmodel->seed = strtoull(seed.c_str(), &endptr, 10);
+	}
+
 	return 0;
 }
 
@@ -244,54 +595,46 @@ int utils::read_and_parse(const string& filename, model *pmodel) {
 	// nwords=?
 	// citer=? // current iteration (when the model was saved)
 
-	FILE *fin = fopen(filename.c_str(), "r");
-	if (!fin) {
+	linereader reader;
+	if (reader.open(filename)) {
 		printf("Cannot open file: %s\n", filename.c_str());
 		return 1;
 	}
 
-	char buff[BUFF_SIZE_SHORT];
-	string line;
-	char *endptr = nullptr;
-
-	while (fgets(buff, BUFF_SIZE_SHORT - 1, fin)) {
-		line = buff;
-		strtokenizer strtok(line, "= \t\r\n");
-		int count = strtok.count_tokens();
-
-		if (count != 2) {
+	string_view line, tokens[2];
+	while (reader.next(line)) {
+		viewtokenizer strtok(line, "= \t\r\n");
+		if (strtok.next(tokens, 2) != 2) {
 			// invalid, ignore this line
 			continue;
 		}
 
-		string optstr = strtok.token(0);
-		string optval = strtok.token(1);
+		string_view optstr = tokens[0];
+		string_view optval = tokens[1];
 
 		if (optstr == "alpha") {
-			pmodel->alpha = strtod(optval.c_str(), &endptr);
+			viewtokenizer::to_double(optval, pmodel->alpha);
 
 		} else if (optstr == "beta") {
-			pmodel->beta = strtod(optval.c_str(), &endptr);
+			viewtokenizer::to_double(optval, pmodel->beta);
 
 		} else if (optstr == "ntopics") {
-			pmodel->K = (int)strtol(optval.c_str(), &endptr, 10);
+			viewtokenizer::to_int(optval, pmodel->K);
 
 		} else if (optstr == "ndocs") {
-			pmodel->M = (int)strtol(optval.c_str(), &endptr, 10);
+			viewtokenizer::to_int(optval, pmodel->M);
 
 		} else if (optstr == "nwords") {
-			pmodel->V = (int)strtol(optval.c_str(), &endptr, 10);
+			viewtokenizer::to_int(optval, pmodel->V);
 
 		} else if (optstr == "liter") {
-			pmodel->liter = (int)strtol(optval.c_str(), &endptr, 10);
+			viewtokenizer::to_int(optval, pmodel->liter);
 
 		} else {
 			// any more?
 		}
 	}
 
-	fclose(fin);
-
 	return 0;
 }
 
@@ -321,6 +664,21 @@ string utils::generate_model_name(int iter) {
 	return model_name;
 }
 
+int utils::file_stamp(const string &filename, uint64_t *size, int64_t *mtime) {
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0) {
+		return 1;
+	}
+	*size = (uint64_t) st.st_size;
+	*mtime = (int64_t) st.st_mtime;
+	return 0;
+}
+
+bool utils::file_exists(const string &filename) {
+	struct stat st;
+	return stat(filename.c_str(), &st) == 0;
+}
+
 void utils::sort(vector<double> &probs, vector<int> &words) {
 	for (size_t i = 0; i < probs.size() - 1; i++) {
 		for (size_t j = i + 1; j < probs.size(); j++) {
@@ -25,6 +25,9 @@
 #define _UTILS_H
 
 #include <string>
+#include <cstdint>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -42,6 +45,24 @@ public:
 	// iter = -1 => final model
 	static string generate_model_name(int iter);
 
+	// size and modification time of a file, returns 1 if it does not exist
+	static int file_stamp(const string &filename, uint64_t *size, int64_t *mtime);
+
+	static bool file_exists(const string &filename);
+
+	// run task(0) .. task(n - 1) on n threads, task(0) on the calling one
+	template<typename Task>
+	static void run_threads(int n, Task task) {
+		vector<thread> threads;
+		for (int t = 1; t < n; t++) {
+			threads.emplace_back(task, t);
+		}
+		task(0);
+		for (auto &th : threads) {
+			th.join();
+		}
+	}
+
 	// sort
 	static void sort(vector<double> &probs, vector<int> &words);
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef _VIEWTOKENIZER_H
+#define _VIEWTOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <charconv>
+
+using namespace std;
+
+// Splits a string into tokens without copying, the tokens are views into the scanned string
+class viewtokenizer {
+public:
+	explicit viewtokenizer(string_view str, const char *separators = " \t\r\n") {
+		this->str = str;
+		pos = 0;
+		for (bool &sep : issep) {
+			sep = false;
+		}
+		for (const char *c = separators; *c; c++) {
+			issep[(unsigned char) *c] = true;
+		}
+	}
+
+	// next token, false if there are no more
+	bool next(string_view &token) {
+		size_t n = str.size();
+		while (pos < n && issep[(unsigned char) str[pos]]) {
+			pos++;
+		}
+		if (pos == n) {
+			return false;
+		}
+		size_t start = pos;
+		while (pos < n && !issep[(unsigned char) str[pos]]) {
+			pos++;
+		}
+		token = str.substr(start, pos - start);
+		return true;
+	}
+
+	// read up to max tokens into tokens[], returns how many there were, at most max + 1 to flag extra ones
+	int next(string_view *tokens, int max) {
+		int count = 0;
+		string_view extra;
+		while (count < max && next(tokens[count])) {
+			count++;
+		}
+		if (count == max && next(extra)) {
+			count++;
+		}
+		return count;
+	}
+
+	// parse a whole token as a number, false if it is not one
+	static bool to_int(string_view token, int &value) {
+		auto result = from_chars(token.data(), token.data() + token.size(), value);
+		return result.ec == errc() && result.ptr == token.data() + token.size();
+	}
+
+	static bool to_double(string_view token, double &value) {
+		auto result = from_chars(token.data(), token.data() + token.size(), value);
+		return result.ec == errc() && result.ptr == token.data() + token.size();
+	}
+
+private:
+	string_view str;
+	size_t pos;
+	bool issep[256];
+};
+
+#endif
+
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <algorithm>
+#include <functional>
+#include "vocabulary.h"
+
+using namespace std;
+
+vocabulary::vocabulary() {
+	nwords = 0;
+	slots.assign(16, -1);
+}
+
+size_t vocabulary::hash(string_view word) {
+	return std::hash<string_view>()(word);
+}
+
+size_t vocabulary::probe(string_view word, size_t h) const {
+	size_t mask = slots.size() - 1;
+	size_t slot = h & mask;
+	while (slots[slot] >= 0) {
+		int id = slots[slot];
+		if (hashes[id] == h && this->word(id) == word) {
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+int vocabulary::find(string_view word) const {
+	return slots[probe(word, hash(word))];
+}
+
+int vocabulary::insert(string_view word) {
+	size_t h = hash(word);
+	size_t slot = probe(word, h);
+	if (slots[slot] >= 0) {
+		return slots[slot];
+	}
+
+	int id = size();
+	offsets.push_back(arena.size());
+	lengths.push_back((uint32_t) word.size());
+	hashes.push_back(h);
+	arena.insert(arena.end(), word.begin(), word.end());
+	slots[slot] = id;
+	nwords++;
+
+	if (2 * (size_t) nwords > slots.size()) {
+		grow();
+	}
+
+	return id;
+}
+
+int vocabulary::add(string_view word, int id) {
+	size_t h = hash(word);
+	size_t slot = probe(word, h);
+	if (slots[slot] >= 0 || id < 0 || has(id)) {
+		return 1;
+	}
+
+	if (id >= size()) {
+		offsets.resize(id + 1, 0);
+		lengths.resize(id + 1, missing);
+		hashes.resize(id + 1, 0);
+	}
+	offsets[id] = arena.size();
+	lengths[id] = (uint32_t) word.size();
+	hashes[id] = h;
+	arena.insert(arena.end(), word.begin(), word.end());
+	slots[slot] = id;
+	nwords++;
+
+	if (2 * (size_t) nwords > slots.size()) {
+		grow();
+	}
+
+	return 0;
+}
+
+void vocabulary::grow() {
+	slots.assign(slots.size() * 2, -1);
+	size_t mask = slots.size() - 1;
+	for (int id = 0; id < size(); id++) {
+		if (lengths[id] == missing) {
+			continue;
+		}
+		size_t slot = hashes[id] & mask;
+		while (slots[slot] >= 0) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = id;
+	}
+}
+
+vector<int> vocabulary::sorted_ids() const {
+	vector<int> ids;
+	ids.reserve(nwords);
+	for (int id = 0; id < size(); id++) {
+		if (lengths[id] != missing) {
+			ids.push_back(id);
+		}
+	}
+	sort(ids.begin(), ids.end(), [this](int a, int b) {
+		return word(a) < word(b);
+	});
+	return ids;
+}
+
+void vocabulary::clear() {
+	vector<char>().swap(arena);
+	vector<size_t>().swap(offsets);
+	vector<uint32_t>().swap(lengths);
+	vector<size_t>().swap(hashes);
+	slots.assign(16, -1);
+	nwords = 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2007 by
+ * 
+ * 	Xuan-Hieu Phan
+ *	hieuxuan@ecei.tohoku.ac.jp or pxhieu@gmail.com
+ * 	Graduate School of Information Sciences
+ * 	Tohoku University
+ *
+ * GibbsLDA++ is a free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * GibbsLDA++ is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GibbsLDA++; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef    _VOCABULARY_H
+#define    _VOCABULARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Word <=> id dictionary
+//
+// The words are interned back to back in one character arena and addressed by id through dense tables, so
+// id => word is an array lookup. word => id goes through an open-addressing hash table (linear probing,
+// at most half full) that stores ids, with the hash of every word kept to skip most string compares and to
+// grow the table without hashing again.
+class vocabulary {
+public:
+	vocabulary();
+
+	// number of ids, i.e. the largest id + 1
+	int size() const {
+		return (int) lengths.size();
+	}
+
+	bool empty() const {
+		return nwords == 0;
+	}
+
+	// whether the id has a word, ids read from a word map file may have gaps
+	bool has(int id) const {
+		return id >= 0 && id < size() && lengths[id] != missing;
+	}
+
+	// the word of an id that has one
+	string_view word(int id) const {
+		return string_view(arena.data() + offsets[id], lengths[id]);
+	}
+
+	// id of a word, -1 if it is not in the vocabulary
+	int find(string_view word) const;
+
+	// id of a word, a new word gets the next id
+	int insert(string_view word);
+
+	// add a word with a given id, returns 1 if the word or the id is taken already
+	int add(string_view word, int id);
+
+	// ids in the lexicographic order of their words
+	vector<int> sorted_ids() const;
+
+	void clear();
+
+private:
+	static constexpr uint32_t missing = UINT32_MAX;
+
+	vector<char> arena;
+	vector<size_t> offsets; // start of the word of each id in arena
+	vector<uint32_t> lengths; // length of the word of each id, missing if the id has no word
+	vector<size_t> hashes; // hash of the word of each id
+	vector<int> slots; // hash table of ids, -1 for an empty slot, the size is a power of two
+	int nwords;
+
+	static size_t hash(string_view word);
+
+	// slot of a word, or the empty slot where it would go
+	size_t probe(string_view word, size_t h) const;
+
+	void grow();
+};
+
+#endif